@@ -0,0 +1,752 @@
+// Microbenchmarks of Trade.C++ with `std::mutex` and `std::atomic` baselines.
+//
+// Usage:
+//
+//   benchmark [--threads 1,2,4] [--seconds 0.5] [--warmup 0.1] [--repeats 3]
+//             [--format text|csv|json] [filter...]
+//
+// Each benchmark matching any filter substring, or every benchmark when no
+// filter is given, is run with each thread count.  A run consists of a warmup
+// period followed by a measured period.  Threads time batches of operations
+// and the latency percentiles are computed from the batch times divided by the
+// batch size.  Throughput is the median over repeats, each of which starts
+// from freshly initialized data and fixed random seeds.
+
+#include "benchmark.hpp"
+
+#include "testing/queue_tm.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Log-linear histogram of nanoseconds with 16 buckets per power of two.
+struct histogram {
+  static constexpr int n_sub = 16, min_log2 = -4, max_log2 = 40;
+  static constexpr int n_buckets = (max_log2 - min_log2) * n_sub;
+
+  uint64_t m_counts[n_buckets] = {};
+  uint64_t m_total = 0;
+
+  void add(double ns, uint64_t n = 1) {
+    auto ix = ns <= 0 ? 0 : static_cast<int>((std::log2(ns) - min_log2) * n_sub);
+    m_counts[std::clamp(ix, 0, n_buckets - 1)] += n;
+    m_total += n;
+  }
+
+  void merge(const histogram &that) {
+    for (int i = 0; i < n_buckets; ++i)
+      m_counts[i] += that.m_counts[i];
+    m_total += that.m_total;
+  }
+
+  double percentile(double p) const {
+    auto rank = static_cast<uint64_t>(std::ceil(p / 100 * m_total));
+    uint64_t n = 0;
+    for (int i = 0; i < n_buckets; ++i)
+      if (rank <= (n += m_counts[i]) && m_counts[i])
+        return std::exp2((i + 0.5) / n_sub + min_log2);
+    return 0;
+  }
+};
+
+template <size_t k> benchmark swap_k(const char *name) {
+  return {name, 0, 64, [](size_t) {
+            constexpr size_t n_atoms = 64;
+            auto atoms = make_atoms<int>(n_atoms, 0);
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                size_t ix[k];
+                random_distinct<k>(seed, n_atoms, ix);
+                atomically([&]() {
+                  int first = atoms[ix[0]];
+                  for (size_t i = 1; i < k; ++i)
+                    atoms[ix[i - 1]] = atoms[ix[i]].load();
+                  atoms[ix[k - 1]] = first;
+                });
+              }
+            }};
+          }};
+}
+
+template <class Config>
+benchmark log_update(const char *name, Config config, size_t n_updates) {
+  return {name, 0, 16, [=](size_t) {
+            constexpr size_t n_atoms = 4096;
+            auto atoms = make_atoms<int>(n_atoms, 0);
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                auto first = random_below(seed, n_atoms - n_updates);
+                atomically(config, [&]() {
+                  for (size_t i = 0; i < n_updates; ++i)
+                    atoms[first + i].ref() += 1;
+                });
+              }
+            }};
+          }};
+}
+
+// Every transaction swaps a decremented and an incremented value between two
+// random atoms out of a few, as in `contention_test`.
+template <class Config>
+benchmark contention_swap(const char *name, Config config) {
+  return {name, 0, 64, [=](size_t) {
+            constexpr size_t n_atoms = 7;
+            auto atoms = make_atoms<int>(n_atoms, 0);
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                size_t ix[2];
+                random_distinct<2>(seed, n_atoms, ix);
+                atomically(config, [&]() {
+                  int &x = atoms[ix[0]].ref();
+                  int &y = atoms[ix[1]].ref();
+                  std::swap(--x, ++y);
+                });
+              }
+            }};
+          }};
+}
+
+// A 256 byte record of which transactions update two members.
+struct record {
+  int64_t m_balance;
+  int64_t m_count;
+  char m_data[240];
+};
+
+// Every transaction updates the two members of a random record either through
+// the whole value or through the members.
+template <bool by_member> benchmark record_update(const char *name) {
+  return {name, 0, 64, [](size_t) {
+            constexpr size_t n_records = 65536;
+            auto records = make_atoms<record>(n_records, record{});
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                auto &r = records[random_below(seed, n_records)];
+                atomically([&]() {
+                  if constexpr (by_member) {
+                    r.ref(&record::m_balance) += 1;
+                    r.ref(&record::m_count) += 1;
+                  } else {
+                    auto &value = r.ref();
+                    value.m_balance += 1;
+                    value.m_count += 1;
+                  }
+                });
+              }
+            }};
+          }};
+}
+
+// Every thread sums `n_reads` consecutive versioned atoms out of `n_atoms` in
+// one transaction while a separate thread keeps transferring between random
+// pairs of the atoms.  The sum is checked when all of the atoms are read.
+template <class Config>
+benchmark
+scan_under_writes(const char *name, Config config, size_t n_reads = 1024) {
+  return {name, 0, 1, [=](size_t) {
+            constexpr size_t n_atoms = 1024;
+            struct state {
+              std::unique_ptr<atom<int, versioned<>>[]> m_atoms{
+                  new atom<int, versioned<>>[n_atoms]};
+              std::atomic<bool> m_done = false;
+              std::thread m_writer;
+            };
+            auto s = std::make_shared<state>();
+            s->m_writer = std::thread([s = s.get()]() {
+              uint32_t seed = 1;
+              while (!s->m_done.load(std::memory_order_relaxed)) {
+                auto i = random_below(seed, n_atoms);
+                auto j = random_below(seed, n_atoms);
+                atomically([&]() {
+                  s->m_atoms[i] = s->m_atoms[i] - 1;
+                  s->m_atoms[j] = s->m_atoms[j] + 1;
+                });
+              }
+            });
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                              for (size_t o = 0; o < n_ops; ++o) {
+                                auto first =
+                                    random_below(seed, n_atoms - n_reads + 1);
+                                auto sum = atomically(config, [&]() {
+                                  int sum = 0;
+                                  for (size_t i = 0; i < n_reads; ++i)
+                                    sum += s->m_atoms[first + i];
+                                  return sum;
+                                });
+                                if (n_reads == n_atoms && sum)
+                                  std::abort();
+                              }
+                            },
+                            [=]() {
+                              s->m_done = true;
+                              s->m_writer.join();
+                            }};
+          }};
+}
+
+// Two threads take turns, each blocking in `retry` until it is its turn after
+// reading `n_reads` other atoms.
+benchmark retry_ping_pong(const char *name, size_t n_reads) {
+  return {name, 2, 16, [=](size_t) {
+            struct state {
+              atom<size_t> m_turn = 0;
+              atom<bool> m_done = false;
+            };
+            auto s = std::make_shared<state>();
+            auto atoms = make_atoms<int>(n_reads, 0);
+            return workload{
+                [=](size_t t, uint32_t &, size_t n_ops) {
+                  for (size_t o = 0; o < n_ops; ++o)
+                    atomically(heap(n_reads * 64 + 1024), [&]() {
+                      if (s->m_done)
+                        return;
+                      int sum = 0;
+                      for (size_t i = 0; i < n_reads; ++i)
+                        sum += atoms[i];
+                      if (s->m_turn != t || sum)
+                        retry();
+                      s->m_turn = 1 - t;
+                    });
+                },
+                [=]() { atomically([&]() { s->m_done = true; }); }};
+          }};
+}
+
+// Philosophers take both of their forks or block in `retry` until both are on
+// the table, yield while eating, and then put the forks back, as in
+// `dining_test`.
+template <class Forks, class Config = stack_t<1024>>
+benchmark retry_dining(const char *name, Config config = stack<1024>) {
+  return {name, Forks::n_forks, 16, [=](size_t n_threads) {
+            auto forks = std::make_shared<Forks>();
+            return workload{
+                [=](size_t t, uint32_t &, size_t n_ops) {
+                  auto &left = forks->m_forks[t];
+                  auto &right = forks->m_forks[(t + 1) % n_threads];
+                  for (size_t o = 0; o < n_ops; ++o) {
+                    atomically(config, [&]() {
+                      if (forks->m_done)
+                        return;
+                      bool &left_on_table = left.ref();
+                      bool &right_on_table = right.ref();
+                      if (left_on_table && right_on_table)
+                        left_on_table = right_on_table = false;
+                      else
+                        retry();
+                    });
+                    std::this_thread::yield();
+                    atomically([&]() { left = right = true; });
+                  }
+                },
+                [=]() { atomically([&]() { forks->m_done = true; }); }};
+          }};
+}
+
+struct hashed_forks {
+  static constexpr size_t n_forks = 5;
+  atom<bool> m_done = false;
+  atom<bool> m_forks[n_forks] = {true, true, true, true, true};
+};
+
+// All forks share a lock, so every commit used to wake every philosopher.
+struct grouped_forks {
+  static constexpr size_t n_forks = 5;
+  atom<bool> m_done = false;
+  lock_group m_group;
+  atom<bool, lock_group> m_forks[n_forks] = {
+      {m_group, true}, {m_group, true}, {m_group, true}, {m_group, true},
+      {m_group, true}};
+};
+
+std::vector<benchmark> benchmarks() {
+  std::vector<benchmark> result;
+
+  result.push_back({"atomic_increment", 0, 64, [](size_t) {
+                      auto counter = std::make_shared<std::atomic<size_t>>(0);
+                      return workload{[=](size_t, uint32_t &, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o)
+                          counter->fetch_add(1);
+                      }};
+                    }});
+
+  result.push_back({"mutex_increment", 0, 64, [](size_t) {
+                      struct state {
+                        std::mutex m_mutex;
+                        size_t m_counter = 0;
+                      };
+                      auto s = std::make_shared<state>();
+                      return workload{[=](size_t, uint32_t &, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o) {
+                          std::unique_lock<std::mutex> guard(s->m_mutex);
+                          s->m_counter += 1;
+                        }
+                      }};
+                    }});
+
+  result.push_back({"mutex_swap_2", 0, 64, [](size_t) {
+                      constexpr size_t n_values = 64;
+                      struct state {
+                        std::mutex m_mutex;
+                        int m_values[n_values] = {};
+                      };
+                      auto s = std::make_shared<state>();
+                      return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o) {
+                          size_t ix[2];
+                          random_distinct<2>(seed, n_values, ix);
+                          std::unique_lock<std::mutex> guard(s->m_mutex);
+                          std::swap(s->m_values[ix[0]], s->m_values[ix[1]]);
+                        }
+                      }};
+                    }});
+
+  result.push_back(
+      {"readonly_load_4", 0, 64, [](size_t) {
+         constexpr size_t n_atoms = 1024;
+         auto atoms = make_atoms<int>(n_atoms, 1);
+         return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+           for (size_t o = 0; o < n_ops; ++o) {
+             size_t ix[4];
+             random_distinct<4>(seed, n_atoms, ix);
+             if (4 != atomically(assume_readonly, [&]() {
+                   return atoms[ix[0]] + atoms[ix[1]] + atoms[ix[2]] +
+                          atoms[ix[3]];
+                 }))
+               std::abort();
+           }
+         }};
+       }});
+
+  result.push_back({"increment_shared", 0, 64, [](size_t) {
+                      auto atoms = make_atoms<size_t>(1, 0);
+                      return workload{[=](size_t, uint32_t &, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o)
+                          atomically([&]() { atoms[0].ref() += 1; });
+                      }};
+                    }});
+
+  result.push_back({"increment_private", 0, 64, [](size_t n_threads) {
+                      // Padded so that threads do not share locks.
+                      auto atoms = make_atoms<size_t>(n_threads * 64, 0);
+                      return workload{[=](size_t t, uint32_t &, size_t n_ops) {
+                        auto &counter = atoms[t * 64];
+                        for (size_t o = 0; o < n_ops; ++o)
+                          atomically([&]() { counter.ref() += 1; });
+                      }};
+                    }});
+
+  result.push_back(swap_k<2>("swap_2"));
+  result.push_back(swap_k<4>("swap_4"));
+  result.push_back(swap_k<8>("swap_8"));
+
+  result.push_back({"update_2_ref", 0, 64, [](size_t) {
+                      constexpr size_t n_atoms = 64;
+                      auto atoms = make_atoms<int>(n_atoms, 0);
+                      return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o) {
+                          size_t ix[2];
+                          random_distinct<2>(seed, n_atoms, ix);
+                          atomically([&]() {
+                            atoms[ix[0]].ref() += 1;
+                            atoms[ix[1]].ref() -= 1;
+                          });
+                        }
+                      }};
+                    }});
+
+  result.push_back({"update_2_load_store", 0, 64, [](size_t) {
+                      constexpr size_t n_atoms = 64;
+                      auto atoms = make_atoms<int>(n_atoms, 0);
+                      return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o) {
+                          size_t ix[2];
+                          random_distinct<2>(seed, n_atoms, ix);
+                          atomically([&]() {
+                            atoms[ix[0]] = atoms[ix[0]] + 1;
+                            atoms[ix[1]] = atoms[ix[1]] - 1;
+                          });
+                        }
+                      }};
+                    }});
+
+  result.push_back(log_update("update_16_stack", stack<2048>, 16));
+  result.push_back(log_update("update_16_heap", heap(2048), 16));
+  result.push_back(log_update("update_256_heap", heap(65536), 256));
+
+  result.push_back(record_update<false>("record_update_whole"));
+  result.push_back(record_update<true>("record_update_members"));
+
+  result.push_back(
+      {"read_256_heap", 0, 16, [](size_t) {
+         constexpr size_t n_atoms = 4096, n_reads = 256;
+         auto atoms = make_atoms<int>(n_atoms, 1);
+         return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+           for (size_t o = 0; o < n_ops; ++o) {
+             auto first = random_below(seed, n_atoms - n_reads);
+             if (n_reads != atomically(heap(65536), [&]() {
+                   size_t sum = 0;
+                   for (size_t i = 0; i < n_reads; ++i)
+                     sum += atoms[first + i];
+                   return sum;
+                 }))
+               std::abort();
+           }
+         }};
+       }});
+
+  result.push_back(scan_under_writes("scan_readonly_writes", assume_readonly));
+  result.push_back(scan_under_writes("scan_snapshot_writes", snapshot));
+  result.push_back(scan_under_writes("scan_10_heap_writes", heap(65536), 10));
+  result.push_back(
+      scan_under_writes("scan_100_heap_writes", heap(65536), 100));
+  result.push_back(
+      scan_under_writes("scan_1000_heap_writes", heap(65536), 1000));
+
+  result.push_back(retry_ping_pong("retry_ping_pong", 0));
+  result.push_back(retry_ping_pong("retry_ping_pong_256", 256));
+  result.push_back(retry_dining<hashed_forks>("retry_dining"));
+  result.push_back(retry_dining<grouped_forks>("retry_dining_grouped"));
+  result.push_back(retry_dining<hashed_forks>("retry_dining_encounter",
+                                              encounter_locking));
+
+  result.push_back(contention_swap("contention_swap", stack<128>));
+  result.push_back(
+      contention_swap("contention_swap_encounter", encounter_locking));
+
+  // A token is passed from one thread to the others and back through queues,
+  // as in `retry_test`, so every handoff wakes every blocked thread.
+  result.push_back({"retry_queue", 4, 16, [](size_t) {
+                      struct state {
+                        atom<bool> m_done = false;
+                        testing::queue_tm<int> m_queues[2];
+                      };
+                      auto s = std::make_shared<state>();
+                      s->m_queues[0].push_back(0);
+                      return workload{
+                          [=](size_t t, uint32_t &, size_t n_ops) {
+                            auto &from = s->m_queues[0 != t];
+                            auto &to = s->m_queues[0 == t];
+                            for (size_t o = 0; o < n_ops; ++o)
+                              atomically([&]() {
+                                if (s->m_done)
+                                  return;
+                                if (auto token = from.try_pop_front())
+                                  to.push_back(*token + 1);
+                                else
+                                  retry();
+                              });
+                          },
+                          [=]() { atomically([&]() { s->m_done = true; }); }};
+                    }});
+
+  result.push_back({"queue_push_pop", 0, 64, [](size_t) {
+                      auto queue = std::make_shared<testing::queue_tm<int>>();
+                      return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                        for (size_t o = 0; o < n_ops; ++o) {
+                          queue->push_back(static_cast<int>(seed));
+                          if (!queue->try_pop_front())
+                            std::abort();
+                          seed = dumpster::ranqd1(seed);
+                        }
+                      }};
+                    }});
+
+  for (auto &b : container_benchmarks())
+    result.push_back(b);
+
+  for (auto &b : application_benchmarks())
+    result.push_back(b);
+
+  return result;
+}
+
+struct options {
+  std::vector<size_t> m_threads;
+  double m_seconds = 0.5;
+  double m_warmup = 0.1;
+  size_t m_repeats = 3;
+  std::string m_format = "text";
+  std::vector<std::string> m_filters;
+};
+
+struct result {
+  const char *m_name;
+  size_t m_n_threads;
+  double m_ops_per_s, m_min_ops_per_s, m_max_ops_per_s;
+  double m_p50_ns, m_p90_ns, m_p99_ns, m_p999_ns;
+  double m_aborts_per_commit, m_spurious_wakeups_per_commit;
+};
+
+result measure(const benchmark &b, size_t n_threads, const options &o) {
+  std::vector<double> rates;
+  histogram latencies;
+  uint64_t n_commits = 0, n_aborts = 0, n_spurious_wakeups = 0;
+
+  for (size_t r = 0; r < o.m_repeats; ++r) {
+    auto w = b.m_setup(n_threads);
+
+    std::atomic<int> phase = 0;
+    std::vector<histogram> histograms(n_threads);
+    std::vector<uint64_t> n_ops(n_threads, 0);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        auto seed = static_cast<uint32_t>(t * 7919 + 1);
+        auto &histogram = histograms[t];
+        while (true) {
+          auto measuring = phase.load(std::memory_order_relaxed);
+          if (2 == measuring)
+            break;
+          auto start = std::chrono::steady_clock::now();
+          w.m_batch(t, seed, b.m_batch_size);
+          std::chrono::duration<double, std::nano> elapsed =
+              std::chrono::steady_clock::now() - start;
+          if (1 == measuring) {
+            histogram.add(elapsed.count() / b.m_batch_size, b.m_batch_size);
+            n_ops[t] += b.m_batch_size;
+          }
+        }
+      }));
+
+    std::this_thread::sleep_for(std::chrono::duration<double>(o.m_warmup));
+    reset_stats();
+    auto start = std::chrono::steady_clock::now();
+    phase = 1;
+    std::this_thread::sleep_for(std::chrono::duration<double>(o.m_seconds));
+    phase = 2;
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    auto s = get_stats();
+    w.m_stop();
+
+    for (auto &thread : threads)
+      thread.join();
+
+    w.m_check();
+
+    uint64_t n_total = 0;
+    for (size_t t = 0; t < n_threads; ++t) {
+      n_total += n_ops[t];
+      latencies.merge(histograms[t]);
+    }
+    rates.push_back(n_total / elapsed.count());
+
+    n_commits += s.n_commits;
+    n_spurious_wakeups += s.n_spurious_wakeups;
+    for (auto n : s.n_aborts)
+      n_aborts += n;
+  }
+
+  std::sort(rates.begin(), rates.end());
+
+  return {b.m_name,
+          n_threads,
+          rates[rates.size() / 2],
+          rates.front(),
+          rates.back(),
+          latencies.percentile(50),
+          latencies.percentile(90),
+          latencies.percentile(99),
+          latencies.percentile(99.9),
+          TRADE_V1_STATS && n_commits ? double(n_aborts) / n_commits : NAN,
+          TRADE_V1_STATS && n_commits ? double(n_spurious_wakeups) / n_commits
+                                      : NAN};
+}
+
+void print_header(const options &o) {
+  if (o.m_format == "csv") {
+    printf("benchmark,threads,ops_per_s,min_ops_per_s,max_ops_per_s,"
+           "p50_ns,p90_ns,p99_ns,p999_ns,aborts_per_commit,"
+           "spurious_wakeups_per_commit\n");
+  } else if (o.m_format == "json") {
+    printf("{\n"
+           "  \"config\": {\"hardware_concurrency\": %u, \"seconds\": %g, "
+           "\"warmup\": %g, \"repeats\": %zu, \"stats\": %d, "
+           "\"abort_longjmp\": %d},\n"
+           "  \"results\": [",
+           std::thread::hardware_concurrency(),
+           o.m_seconds,
+           o.m_warmup,
+           o.m_repeats,
+           TRADE_V1_STATS,
+           TRADE_V1_ABORT_LONGJMP);
+  } else {
+    printf("%-20s %7s %12s %9s %9s %9s %9s %9s %9s\n",
+           "benchmark",
+           "threads",
+           "Mops/s",
+           "p50 ns",
+           "p90 ns",
+           "p99 ns",
+           "p99.9 ns",
+           "aborts",
+           "wakeups");
+  }
+}
+
+void print_result(const options &o, const result &r, bool first) {
+  if (o.m_format == "csv") {
+    printf("%s,%zu,%.0f,%.0f,%.0f,%.1f,%.1f,%.1f,%.1f,",
+           r.m_name,
+           r.m_n_threads,
+           r.m_ops_per_s,
+           r.m_min_ops_per_s,
+           r.m_max_ops_per_s,
+           r.m_p50_ns,
+           r.m_p90_ns,
+           r.m_p99_ns,
+           r.m_p999_ns);
+    if (!std::isnan(r.m_aborts_per_commit))
+      printf("%.4f,%.4f",
+             r.m_aborts_per_commit,
+             r.m_spurious_wakeups_per_commit);
+    else
+      printf(",");
+    printf("\n");
+  } else if (o.m_format == "json") {
+    printf("%s\n    {\"benchmark\": \"%s\", \"threads\": %zu, "
+           "\"ops_per_s\": %.0f, \"min_ops_per_s\": %.0f, "
+           "\"max_ops_per_s\": %.0f, \"p50_ns\": %.1f, \"p90_ns\": %.1f, "
+           "\"p99_ns\": %.1f, \"p999_ns\": %.1f, ",
+           first ? "" : ",",
+           r.m_name,
+           r.m_n_threads,
+           r.m_ops_per_s,
+           r.m_min_ops_per_s,
+           r.m_max_ops_per_s,
+           r.m_p50_ns,
+           r.m_p90_ns,
+           r.m_p99_ns,
+           r.m_p999_ns);
+    if (std::isnan(r.m_aborts_per_commit))
+      printf("\"aborts_per_commit\": null, "
+             "\"spurious_wakeups_per_commit\": null}");
+    else
+      printf("\"aborts_per_commit\": %.4f, "
+             "\"spurious_wakeups_per_commit\": %.4f}",
+             r.m_aborts_per_commit,
+             r.m_spurious_wakeups_per_commit);
+  } else {
+    printf("%-20s %7zu %12.3f %9.1f %9.1f %9.1f %9.1f ",
+           r.m_name,
+           r.m_n_threads,
+           r.m_ops_per_s / 1000000.0,
+           r.m_p50_ns,
+           r.m_p90_ns,
+           r.m_p99_ns,
+           r.m_p999_ns);
+    if (std::isnan(r.m_aborts_per_commit))
+      printf("%9s %9s\n", "-", "-");
+    else
+      printf("%9.4f %9.4f\n",
+             r.m_aborts_per_commit,
+             r.m_spurious_wakeups_per_commit);
+  }
+  fflush(stdout);
+}
+
+void print_footer(const options &o) {
+  if (o.m_format == "json")
+    printf("\n  ]\n}\n");
+}
+
+bool parse(int argc, char **argv, options &o) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.size() < 2 || arg.compare(0, 2, "--")) {
+      o.m_filters.push_back(arg);
+      continue;
+    }
+    if (argc <= i + 1)
+      return false;
+    std::string value = argv[++i];
+    char *end;
+    if (arg == "--threads") {
+      for (auto p = value.c_str(); *p; p = *end ? end + 1 : end) {
+        auto n = strtoul(p, &end, 10);
+        if (end == p || !n || (*end && *end != ','))
+          return false;
+        o.m_threads.push_back(n);
+      }
+    } else if (arg == "--seconds") {
+      o.m_seconds = strtod(value.c_str(), &end);
+      if (*end || !(0 < o.m_seconds))
+        return false;
+    } else if (arg == "--warmup") {
+      o.m_warmup = strtod(value.c_str(), &end);
+      if (*end || !(0 <= o.m_warmup))
+        return false;
+    } else if (arg == "--repeats") {
+      o.m_repeats = strtoul(value.c_str(), &end, 10);
+      if (*end || !o.m_repeats)
+        return false;
+    } else if (arg == "--format") {
+      o.m_format = value;
+      if (value != "text" && value != "csv" && value != "json")
+        return false;
+    } else {
+      return false;
+    }
+  }
+
+  if (o.m_threads.empty()) {
+    size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+    for (size_t n = 1; n < max_threads; n *= 2)
+      o.m_threads.push_back(n);
+    o.m_threads.push_back(max_threads);
+  }
+
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  options o;
+  if (!parse(argc, argv, o)) {
+    fprintf(stderr,
+            "usage: %s [--threads 1,2,4] [--seconds 0.5] [--warmup 0.1] "
+            "[--repeats 3] [--format text|csv|json] [filter...]\n",
+            argv[0]);
+    return 2;
+  }
+
+  print_header(o);
+
+  bool first = true;
+  for (auto &b : benchmarks()) {
+    if (!o.m_filters.empty() &&
+        std::none_of(o.m_filters.begin(), o.m_filters.end(), [&](auto &f) {
+          return std::strstr(b.m_name, f.c_str());
+        }))
+      continue;
+
+    if (b.m_n_threads) {
+      print_result(o, measure(b, b.m_n_threads, o), first);
+      first = false;
+    } else {
+      for (auto n_threads : o.m_threads) {
+        print_result(o, measure(b, n_threads, o), first);
+        first = false;
+      }
+    }
+  }
+
+  print_footer(o);
+
+  return 0;
+}
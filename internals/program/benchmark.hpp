@@ -0,0 +1,69 @@
+#pragma once
+
+#include "trade_v1/trade.hpp"
+
+#include "dumpster_v1/ranqd1.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+using namespace trade_v1;
+
+// Performs `n_ops` operations as the given thread.
+using batch_t =
+    std::function<void(size_t thread, uint32_t &seed, size_t n_ops)>;
+
+struct workload {
+  batch_t m_batch;
+
+  // Unblocks threads that may be waiting for other threads.
+  std::function<void()> m_stop = []() {};
+
+  // Verifies invariants after all threads have stopped.
+  std::function<void()> m_check = []() {};
+};
+
+struct benchmark {
+  const char *m_name;
+
+  // Fixed number of threads or `0` for a thread count sweep.
+  size_t m_n_threads;
+
+  size_t m_batch_size;
+
+  std::function<workload(size_t n_threads)> m_setup;
+};
+
+inline size_t random_below(uint32_t &seed, size_t n) {
+  return (seed = dumpster::ranqd1(seed)) % n;
+}
+
+template <class Value>
+std::shared_ptr<atom<Value>[]> make_atoms(size_t n, Value value) {
+  std::shared_ptr<atom<Value>[]> atoms(new atom<Value>[n]);
+  for (size_t i = 0; i < n; ++i)
+    atomically([&]() { atoms[i] = value; });
+  return atoms;
+}
+
+// Picks `k` distinct indices below `n`.
+template <size_t k>
+void random_distinct(uint32_t &seed, size_t n, size_t *ix) {
+  for (size_t i = 0; i < k; ++i) {
+    bool again;
+    do {
+      ix[i] = random_below(seed, n);
+      again = false;
+      for (size_t j = 0; j < i; ++j)
+        again |= ix[i] == ix[j];
+    } while (again);
+  }
+}
+
+// Benchmarks of STAMP style application workloads.
+std::vector<benchmark> application_benchmarks();
+
+// Benchmarks of provided transactional containers.
+std::vector<benchmark> container_benchmarks();
@@ -0,0 +1,252 @@
+// Benchmarks of provided transactional containers against lock based
+// counterparts.  Operations are uniformly random over a fixed range of keys of
+// which about half are present.
+
+#include "benchmark.hpp"
+
+#include "trade_v1/bounded_queue_tm.hpp"
+#include "trade_v1/counter.hpp"
+#include "trade_v1/hash_map_tm.hpp"
+#include "trade_v1/skiplist_tm.hpp"
+
+#include "testing/queue_tm.hpp"
+
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+constexpr size_t n_keys = 65536;
+
+// A `std::unordered_map` split into stripes each protected by a mutex.
+class hash_map_striped {
+  static constexpr size_t n_stripes = 64;
+
+  struct alignas(64) stripe_t {
+    std::mutex m_mutex;
+    std::unordered_map<int, int> m_map;
+  };
+
+  stripe_t m_stripes[n_stripes];
+
+  stripe_t &stripe(int key) {
+    return m_stripes[std::hash<int>()(key) % n_stripes];
+  }
+
+public:
+  bool find(int key) {
+    auto &s = stripe(key);
+    std::unique_lock<std::mutex> guard(s.m_mutex);
+    return s.m_map.count(key);
+  }
+
+  bool insert(int key, int value) {
+    auto &s = stripe(key);
+    std::unique_lock<std::mutex> guard(s.m_mutex);
+    return s.m_map.emplace(key, value).second;
+  }
+
+  bool erase(int key) {
+    auto &s = stripe(key);
+    std::unique_lock<std::mutex> guard(s.m_mutex);
+    return s.m_map.erase(key);
+  }
+};
+
+// Performs the given percentage of finds and otherwise inserts and erases in
+// equal proportions.
+template <class Map>
+benchmark hash_map(const char *name, size_t find_percentage) {
+  return {name, 0, 64, [=](size_t) {
+            auto map = std::make_shared<Map>();
+            uint32_t seed = 1;
+            for (size_t i = 0; i < n_keys / 2; ++i)
+              map->insert(static_cast<int>(random_below(seed, n_keys)), 0);
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                auto key = static_cast<int>(random_below(seed, n_keys));
+                auto op = random_below(seed, 100);
+                if (op < find_percentage)
+                  map->find(key);
+                else if (op & 1)
+                  map->insert(key, static_cast<int>(o));
+                else
+                  map->erase(key);
+              }
+            }};
+          }};
+}
+
+// A `std::map` protected by a single mutex.
+class ordered_map_locked {
+  std::mutex m_mutex;
+  std::map<int, int> m_map;
+
+public:
+  bool insert(int key, int value) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    return m_map.emplace(key, value).second;
+  }
+
+  template <class Function> void scan(int from, Function &&fn) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    for (auto it = m_map.lower_bound(from); it != m_map.end(); ++it)
+      if (!fn(it->first, it->second))
+        break;
+  }
+
+  std::optional<std::pair<int, int>> try_pop_min() {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    if (m_map.empty())
+      return std::nullopt;
+    auto min = *m_map.begin();
+    m_map.erase(m_map.begin());
+    return min;
+  }
+};
+
+// Performs inserts, scans of up to `n_scanned` elements, and pops of the
+// minimum in proportions 2:1:1.  The map stays at about half of the keys.
+template <class Map> benchmark ordered_map(const char *name) {
+  constexpr size_t n_scanned = 8;
+  return {name, 0, 64, [](size_t) {
+            auto map = std::make_shared<Map>();
+            uint32_t seed = 1;
+            for (size_t i = 0; i < n_keys / 2; ++i)
+              map->insert(static_cast<int>(random_below(seed, n_keys)), 0);
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                auto key = static_cast<int>(random_below(seed, n_keys));
+                switch (random_below(seed, 4)) {
+                case 0:
+                case 1:
+                  map->insert(key, static_cast<int>(o));
+                  break;
+                case 2: {
+                  size_t n = 0;
+                  map->scan(key, [&](int, int) { return ++n < n_scanned; });
+                  break;
+                }
+                default:
+                  map->try_pop_min();
+                }
+              }
+            }};
+          }};
+}
+
+// A `std::deque` protected by a single mutex.
+class queue_locked {
+  std::mutex m_mutex;
+  std::deque<int> m_deque;
+
+public:
+  void push_back(int value) {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_deque.push_back(value);
+  }
+
+  std::optional<int> try_pop_front() {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    if (m_deque.empty())
+      return std::nullopt;
+    auto value = m_deque.front();
+    m_deque.pop_front();
+    return value;
+  }
+};
+
+constexpr size_t n_queued = 64;
+
+// Every thread both pushes and pops, so that no thread blocks.  The queue is
+// kept at about `n_queued` elements, so that pushes and pops access different
+// ends of the queue.
+template <class Queue>
+benchmark queue_mpmc(const char *name, std::function<Queue *()> make) {
+  return {name, 0, 64, [=](size_t) {
+            std::shared_ptr<Queue> queue(make());
+            for (size_t i = 0; i < n_queued; ++i)
+              queue->push_back(static_cast<int>(i));
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                queue->push_back(static_cast<int>(seed));
+                if (!queue->try_pop_front())
+                  std::abort();
+                seed = dumpster::ranqd1(seed);
+              }
+            }};
+          }};
+}
+
+// Like `queue_mpmc`, but pushes and pops `n_bulk` elements at a time.
+benchmark queue_mpmc_bulk() {
+  constexpr size_t n_bulk = 8;
+  return {"bounded_queue_tm_mpmc_bulk", 0, 8, [](size_t n_threads) {
+            auto queue = std::make_shared<bounded_queue_tm<int>>(
+                n_queued + n_bulk * n_threads);
+            for (size_t i = 0; i < n_queued; ++i)
+              queue->push_back(static_cast<int>(i));
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+              int values[n_bulk];
+              for (size_t o = 0; o < n_ops; ++o) {
+                for (auto &value : values)
+                  value = static_cast<int>(seed = dumpster::ranqd1(seed));
+                queue->push_back_n(values, n_bulk);
+                for (size_t n = 0; n < n_bulk;)
+                  n += queue->pop_front_n(values, n_bulk - n);
+              }
+            }};
+          }};
+}
+
+// Adds to a shared counter.  Compare with `increment_shared`, which reads and
+// writes a single atom.
+benchmark counter_add() {
+  return {"counter_add", 0, 64, [](size_t) {
+            auto count = std::make_shared<counter<size_t>>();
+            return workload{[=](size_t, uint32_t &, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o)
+                count->add(1);
+            }};
+          }};
+}
+
+// Every thread adds and then takes, so that takes never block.
+benchmark counter_add_take() {
+  return {"counter_add_take", 0, 64, [](size_t) {
+            auto count = std::make_shared<counter<size_t>>();
+            return workload{[=](size_t, uint32_t &, size_t n_ops) {
+              for (size_t o = 0; o < n_ops; ++o) {
+                count->add(1);
+                count->take(1);
+              }
+            }};
+          }};
+}
+
+} // namespace
+
+std::vector<benchmark> container_benchmarks() {
+  return {hash_map<hash_map_tm<int, int>>("hash_map_tm_find_90", 90),
+          hash_map<hash_map_striped>("hash_map_mutex_find_90", 90),
+          hash_map<hash_map_tm<int, int>>("hash_map_tm_find_50", 50),
+          hash_map<hash_map_striped>("hash_map_mutex_find_50", 50),
+          ordered_map<skiplist_tm<int, int>>("skiplist_tm_mixed"),
+          ordered_map<ordered_map_locked>("skiplist_mutex_mixed"),
+          queue_mpmc<bounded_queue_tm<int>>(
+              "bounded_queue_tm_mpmc",
+              []() { return new bounded_queue_tm<int>(1024); }),
+          queue_mpmc_bulk(),
+          queue_mpmc<testing::queue_tm<int>>(
+              "queue_tm_mpmc", []() { return new testing::queue_tm<int>(); }),
+          queue_mpmc<queue_locked>("queue_mutex_mpmc",
+                                   []() { return new queue_locked(); }),
+          counter_add(),
+          counter_add_take()};
+}
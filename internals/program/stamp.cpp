@@ -0,0 +1,393 @@
+// Application workloads in the style of the STAMP benchmark suite.  Every
+// operation is one application level transaction, so the reported aborts per
+// commit also count aborts of nested `queue_tm` operations as a whole.
+
+#include "benchmark.hpp"
+
+#include "testing/queue_tm.hpp"
+
+#include "polyfill_v1/memory.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+void check(bool ok) {
+  if (!ok)
+    std::abort();
+}
+
+// Transfers between accounts with occasional audits of the total balance.
+// Audits read every account and are prone to starvation, so transactions are
+// escalated to irrevocable mode after a number of aborts.
+benchmark bank() {
+  return {"bank", 0, 16, [](size_t) {
+            constexpr size_t n_accounts = 1024;
+            constexpr int initial_balance = 1000;
+            constexpr int total = n_accounts * initial_balance;
+
+            auto accounts = make_atoms<int>(n_accounts, initial_balance);
+
+            auto audit = [=]() {
+              return atomically(assume_readonly, [&]() {
+                int sum = 0;
+                for (size_t i = 0; i < n_accounts; ++i)
+                  sum += accounts[i];
+                return sum;
+              });
+            };
+
+            set_escalation_threshold(64);
+
+            return workload{[=](size_t, uint32_t &seed, size_t n_ops) {
+                              for (size_t o = 0; o < n_ops; ++o) {
+                                if (0 == random_below(seed, 100)) {
+                                  check(total == audit());
+                                } else {
+                                  size_t ix[2];
+                                  random_distinct<2>(seed, n_accounts, ix);
+                                  int amount = 1 + random_below(seed, 100);
+                                  atomically([&]() {
+                                    accounts[ix[0]].ref() -= amount;
+                                    accounts[ix[1]].ref() += amount;
+                                  });
+                                }
+                              }
+                            },
+                            []() {},
+                            [=]() {
+                              set_escalation_threshold(0);
+                              check(total == audit());
+                            }};
+          }};
+}
+
+// A travel reservation system with tables of cars, flights, and rooms keyed by
+// hashed ids and customers with lists of reservations.
+benchmark vacation() {
+  return {"vacation", 0, 16, [](size_t) {
+            constexpr size_t n_tables = 3, n_items = 1024, n_slots = 2048,
+                             n_customers = 1024, n_queries = 4;
+            constexpr int capacity = 100;
+
+            struct item_t {
+              atom<int> m_n_free = capacity;
+              atom<int> m_price = 0;
+            };
+
+            // Open addressing table with ids fixed at construction.
+            struct table_t {
+              uint32_t m_ids[n_slots] = {};
+              item_t m_items[n_slots];
+
+              item_t *find(uint32_t id) {
+                for (size_t i = id % n_slots;; i = (i + 1) % n_slots)
+                  if (m_ids[i] == id)
+                    return &m_items[i];
+                  else if (!m_ids[i])
+                    return nullptr;
+              }
+
+              void add(uint32_t id, int price) {
+                auto i = id % n_slots;
+                while (m_ids[i])
+                  i = (i + 1) % n_slots;
+                m_ids[i] = id;
+                atomically([&]() { m_items[i].m_price = price; });
+              }
+            };
+
+            struct reservation_t {
+              item_t *m_item;
+              int m_price;
+              std::shared_ptr<const reservation_t> m_next;
+            };
+
+            struct customer_t {
+              atom<int> m_bill = 0;
+              atom<std::shared_ptr<const reservation_t>> m_reservations;
+            };
+
+            struct state_t {
+              table_t m_tables[n_tables];
+              std::vector<uint32_t> m_ids[n_tables];
+              customer_t m_customers[n_customers];
+            };
+
+            std::shared_ptr<state_t> s(new state_t());
+
+            uint32_t seed = 1;
+            for (size_t t = 0; t < n_tables; ++t)
+              for (size_t i = 0; i < n_items; ++i) {
+                uint32_t id;
+                do
+                  id = (seed = dumpster::ranqd1(seed));
+                while (!id || s->m_tables[t].find(id));
+                s->m_tables[t].add(id, 50 + random_below(seed, 500));
+                s->m_ids[t].push_back(id);
+              }
+
+            auto reserve = [=](uint32_t &seed) {
+              item_t *queried[n_queries];
+              for (auto &item : queried) {
+                auto t = random_below(seed, n_tables);
+                item = s->m_tables[t].find(
+                    s->m_ids[t][random_below(seed, n_items)]);
+              }
+              auto &customer = s->m_customers[random_below(seed, n_customers)];
+
+              atomically([&]() {
+                item_t *best = nullptr;
+                int best_price = 0;
+                for (auto item : queried) {
+                  int price = item->m_price;
+                  if (0 < item->m_n_free && best_price < price) {
+                    best = item;
+                    best_price = price;
+                  }
+                }
+                if (best) {
+                  best->m_n_free.ref() -= 1;
+                  customer.m_bill.ref() += best_price;
+                  customer.m_reservations =
+                      std::make_shared<const reservation_t>(reservation_t{
+                          best, best_price, customer.m_reservations});
+                }
+              });
+            };
+
+            auto remove_customer = [=](uint32_t &seed) {
+              auto &customer = s->m_customers[random_below(seed, n_customers)];
+              atomically(heap(4096), [&]() {
+                for (auto it = customer.m_reservations.load(); it;
+                     it = it->m_next)
+                  it->m_item->m_n_free.ref() += 1;
+                customer.m_reservations = nullptr;
+                customer.m_bill = 0;
+              });
+            };
+
+            auto update_price = [=](uint32_t &seed) {
+              auto t = random_below(seed, n_tables);
+              auto item = s->m_tables[t].find(
+                  s->m_ids[t][random_below(seed, n_items)]);
+              int price = 50 + random_below(seed, 500);
+              atomically([&]() { item->m_price = price; });
+            };
+
+            return workload{
+                [=](size_t, uint32_t &seed, size_t n_ops) {
+                  for (size_t o = 0; o < n_ops; ++o) {
+                    auto action = random_below(seed, 100);
+                    if (action < 90)
+                      reserve(seed);
+                    else if (action < 95)
+                      remove_customer(seed);
+                    else
+                      update_price(seed);
+                  }
+                },
+                []() {},
+                [=]() {
+                  atomically(assume_readonly, [&]() {
+                    std::unordered_map<const item_t *, int> n_reserved;
+                    for (auto &customer : s->m_customers) {
+                      int bill = 0;
+                      for (auto it = customer.m_reservations.load(); it;
+                           it = it->m_next) {
+                        bill += it->m_price;
+                        n_reserved[it->m_item] += 1;
+                      }
+                      check(bill == customer.m_bill);
+                    }
+                    for (auto &table : s->m_tables)
+                      for (size_t i = 0; i < n_slots; ++i)
+                        if (table.m_ids[i])
+                          check(capacity == table.m_items[i].m_n_free +
+                                                n_reserved[&table.m_items[i]]);
+                  });
+                }};
+          }};
+}
+
+// Assignment of points to the nearest of a number of cluster centres with
+// transactional accumulation of the new centres.
+benchmark kmeans() {
+  return {"kmeans", 0, 64, [](size_t) {
+            constexpr size_t n_points = 16384, n_dims = 4, n_clusters = 16;
+
+            struct cluster_t {
+              float m_centre[n_dims];
+              atom<double> m_sums[n_dims];
+              atom<int> m_n_points = 0;
+            };
+
+            struct state_t {
+              float m_points[n_points][n_dims];
+              cluster_t m_clusters[n_clusters];
+              std::atomic<uint64_t> m_n_assigned = 0;
+            };
+
+            std::shared_ptr<state_t> s(new state_t());
+
+            uint32_t seed = 1;
+            for (auto &point : s->m_points)
+              for (auto &x : point)
+                x = random_below(seed, 1000) / 1000.0f;
+            for (size_t c = 0; c < n_clusters; ++c)
+              for (size_t d = 0; d < n_dims; ++d) {
+                s->m_clusters[c].m_centre[d] = s->m_points[c][d];
+                atomically([&]() { s->m_clusters[c].m_sums[d] = 0.0; });
+              }
+
+            return workload{
+                [=](size_t, uint32_t &seed, size_t n_ops) {
+                  for (size_t o = 0; o < n_ops; ++o) {
+                    auto &point = s->m_points[random_below(seed, n_points)];
+
+                    size_t nearest = 0;
+                    float nearest_distance = 0;
+                    for (size_t c = 0; c < n_clusters; ++c) {
+                      float distance = 0;
+                      for (size_t d = 0; d < n_dims; ++d) {
+                        auto delta = point[d] - s->m_clusters[c].m_centre[d];
+                        distance += delta * delta;
+                      }
+                      if (!c || distance < nearest_distance) {
+                        nearest = c;
+                        nearest_distance = distance;
+                      }
+                    }
+
+                    auto &cluster = s->m_clusters[nearest];
+                    atomically([&]() {
+                      for (size_t d = 0; d < n_dims; ++d)
+                        cluster.m_sums[d].ref() += point[d];
+                      cluster.m_n_points.ref() += 1;
+                    });
+                    s->m_n_assigned.fetch_add(1, std::memory_order_relaxed);
+                  }
+                },
+                []() {},
+                [=]() {
+                  uint64_t n_points = 0;
+                  for (auto &cluster : s->m_clusters)
+                    n_points += cluster.m_n_points.unsafe_load();
+                  check(n_points == s->m_n_assigned);
+                }};
+          }};
+}
+
+// A pipeline that splits flows into fragments, reassembles flows from the
+// fragments in any order, and passes completed flows to a detector, which
+// returns the flow slots for reuse.
+benchmark intruder() {
+  return {"intruder", 0, 64, [](size_t) {
+            constexpr size_t n_flows = 1024, max_fragments = 8;
+
+            struct flow_t {
+              atom<int> m_n_fragments = 0;
+              atom<int> m_n_received = 0;
+            };
+
+            struct state_t {
+              flow_t m_flows[n_flows];
+              testing::queue_tm<uint32_t> m_fragments;
+              testing::queue_tm<uint32_t> m_completed;
+              testing::queue_tm<uint32_t> m_free;
+            };
+
+            std::shared_ptr<state_t> s(new state_t());
+
+            for (uint32_t f = 0; f < n_flows; ++f)
+              s->m_free.push_back(f);
+
+            // Receives a fragment and completes its flow once all fragments
+            // of the flow have been received.
+            auto receive = [=]() {
+              return atomically([&]() {
+                auto fragment = s->m_fragments.try_pop_front();
+                if (!fragment)
+                  return false;
+                auto f = *fragment / max_fragments;
+                auto &flow = s->m_flows[f];
+                int n_received = flow.m_n_received + 1;
+                if (n_received < flow.m_n_fragments) {
+                  flow.m_n_received = n_received;
+                } else {
+                  flow.m_n_fragments = flow.m_n_received = 0;
+                  s->m_completed.push_back(f);
+                }
+                return true;
+              });
+            };
+
+            auto detect = [=]() {
+              return atomically([&]() {
+                auto f = s->m_completed.try_pop_front();
+                if (!f)
+                  return false;
+                s->m_free.push_back(*f);
+                return true;
+              });
+            };
+
+            auto send = [=](uint32_t &seed) {
+              auto n_fragments = 2 + random_below(seed, max_fragments - 1);
+              uint32_t order[max_fragments];
+              for (uint32_t i = 0; i < n_fragments; ++i)
+                order[i] = i;
+              for (size_t i = n_fragments; 1 < i; --i)
+                std::swap(order[i - 1], order[random_below(seed, i)]);
+              atomically(heap(4096), [&]() {
+                if (auto f = s->m_free.try_pop_front()) {
+                  s->m_flows[*f].m_n_fragments =
+                      static_cast<int>(n_fragments);
+                  for (size_t i = 0; i < n_fragments; ++i)
+                    s->m_fragments.push_back(*f * max_fragments + order[i]);
+                }
+              });
+            };
+
+            return workload{
+                [=](size_t, uint32_t &seed, size_t n_ops) {
+                  for (size_t o = 0; o < n_ops; ++o)
+                    if (!receive() && !detect())
+                      send(seed);
+                },
+                []() {},
+                [=]() {
+                  std::vector<uint32_t> fragments = s->m_fragments;
+                  size_t n_pending[n_flows] = {};
+                  for (auto fragment : fragments)
+                    n_pending[fragment / max_fragments] += 1;
+
+                  size_t n_in_progress = 0;
+                  for (size_t f = 0; f < n_flows; ++f) {
+                    auto &flow = s->m_flows[f];
+                    if (flow.m_n_fragments.unsafe_load()) {
+                      n_in_progress += 1;
+                      check(flow.m_n_received.unsafe_load() + n_pending[f] ==
+                            static_cast<size_t>(
+                                flow.m_n_fragments.unsafe_load()));
+                    } else {
+                      check(0 == n_pending[f]);
+                    }
+                  }
+                  check(n_in_progress + s->m_completed.size() +
+                            s->m_free.size() ==
+                        n_flows);
+                }};
+          }};
+}
+
+} // namespace
+
+std::vector<benchmark> application_benchmarks() {
+  return {bank(), vacation(), kmeans(), intruder()};
+}
@@ -0,0 +1,118 @@
+#include "trade_v1/trade.hpp"
+
+#include "polyfill_v1/memory.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+static volatile size_t s_depth;
+
+static void nested_retry(size_t depth, bool should_retry) {
+  if (depth) {
+    nested_retry(depth - 1, should_retry);
+    s_depth = depth;
+  } else if (should_retry) {
+    retry();
+  }
+}
+
+auto abort_test = test([]() {
+  fprintf(stderr,
+          "aborts by %s\n",
+          TRADE_V1_ABORT_LONGJMP ? "longjmp" : "exceptions");
+
+#if TRADE_V1_EXCEPTIONS
+  {
+    auto p = std::make_shared<int>(1);
+    atom<std::shared_ptr<int>> x(p);
+
+    bool thrown = false;
+    try {
+      atomically([&]() {
+        x = std::make_shared<int>(3);
+        throw std::runtime_error("user");
+      });
+    } catch (std::runtime_error &) {
+      thrown = true;
+    }
+
+    verify(thrown);
+    verify(x.unsafe_load() == p);
+    verify(2 == p.use_count());
+  }
+#endif
+
+  {
+    atom<int> x = 0;
+    int n_attempts = 0;
+
+    atomically([&]() {
+      if (++n_attempts < 3)
+        nested_retry(2, true);
+      x.ref() += 1;
+    });
+
+    verify(3 == n_attempts);
+    verify(1 == x.unsafe_load());
+  }
+
+  {
+    atom<int> x = 0;
+    int n_attempts = 0;
+    int values[2] = {0, 0};
+
+    // Results returned by reference survive the restarts.
+    int &value = atomically([&]() -> int & {
+      if (++n_attempts < 3)
+        nested_retry(2, true);
+      return values[x];
+    });
+
+    verify(3 == n_attempts);
+    verify(&values[0] == &value);
+  }
+
+  {
+    int n_attempts = 0, n_calls = 0;
+    auto call = [](void *n_calls) { *static_cast<int *>(n_calls) += 1; };
+
+    // Actions registered by aborted attempts are dropped.
+    atomically([&]() {
+      after_commit(call, &n_calls);
+      if (++n_attempts < 3)
+        nested_retry(2, true);
+      verify(0 == n_calls);
+    });
+
+    verify(3 == n_attempts);
+    verify(1 == n_calls);
+  }
+
+  const size_t n_aborts = 100000;
+
+  for (size_t depth : {0, 8, 64}) {
+    size_t n = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    atomically([&]() {
+      nested_retry(depth, ++n < n_aborts);
+    });
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    fprintf(stderr,
+            "%zu frames deep: %f ns per abort\n",
+            depth,
+            elapsed.count() / n_aborts * 1000000000.0);
+
+    verify(n_aborts == n);
+  }
+});
@@ -0,0 +1,52 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto access_set_test = test([]() {
+  for (size_t n_atoms : {1, 2, 8, 9, 64, 1024}) {
+    std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+
+    atomically(heap(0), [&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        atoms[i] = 0;
+    });
+
+    const size_t n_transactions = 1000000 / n_atoms;
+
+    size_t total = 0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Each atom is first read and then updated, which means that half of the
+    // accesses find the atom already in the access set.
+    for (size_t t = 0; t < n_transactions; ++t)
+      total += atomically(heap(n_atoms * 64), [&]() {
+        size_t sum = 0;
+        for (size_t i = 0; i < n_atoms; ++i)
+          sum += atoms[i];
+        for (size_t i = n_atoms; i--;)
+          atoms[i].ref() += 1;
+        return sum;
+      });
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    fprintf(stderr,
+            "%zu atoms: %f ns per access\n",
+            n_atoms,
+            elapsed.count() / (2 * n_atoms * n_transactions) * 1000000000.0);
+
+    verify(n_atoms * n_transactions * (n_transactions - 1) / 2 == total);
+    atomically(assume_readonly, [&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        verify(static_cast<int>(n_transactions) == atoms[i]);
+    });
+  }
+});
@@ -0,0 +1,92 @@
+#include "trade_v1/bounded_queue_tm.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto bounded_queue_test = test([]() {
+  {
+    bounded_queue_tm<std::shared_ptr<int>> queue(3);
+
+    verify(queue.empty());
+    verify(queue.try_push_back(std::make_shared<int>(1)));
+    verify(queue.try_push_back(std::make_shared<int>(2)));
+    verify(queue.try_push_back(std::make_shared<int>(3)));
+    verify(!queue.try_push_back(std::make_shared<int>(4)));
+    verify(3 == queue.size());
+
+    verify(1 == *queue.pop_front());
+    std::shared_ptr<int> values[3];
+    verify(2 == queue.pop_front_n(values, 3));
+    verify(2 == *values[0] && 3 == *values[1]);
+    verify(!queue.try_pop_front());
+    verify(queue.empty());
+
+    // Operations compose inside a transaction.
+    queue.push_back(std::make_shared<int>(5));
+    atomically([&]() {
+      auto value = queue.pop_front();
+      queue.push_back(std::make_shared<int>(*value + 1));
+    });
+    verify(6 == **queue.try_pop_front());
+  }
+
+  {
+    bounded_queue_tm<int> queue(8);
+
+    const int n_values = 10000;
+    const size_t n_producers =
+        std::max(std::thread::hardware_concurrency() / 2, 1u);
+
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < n_producers; ++t)
+      producers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < n_values; i += 4) {
+          int values[4];
+          for (int j = 0; j < 4; ++j)
+            values[j] = static_cast<int>((i + j) * n_producers + t);
+          if (i & 4) {
+            queue.push_back_n(values, 4);
+          } else {
+            for (auto value : values)
+              queue.push_back(value);
+          }
+        }
+      }));
+
+    std::vector<int> popped;
+    std::thread consumer([&]() {
+      int values[3];
+      while (popped.size() < n_values * n_producers) {
+        if (popped.size() & 1) {
+          popped.push_back(queue.pop_front());
+        } else {
+          auto n = queue.pop_front_n(values, 3);
+          popped.insert(popped.end(), values, values + n);
+        }
+      }
+    });
+
+    for (auto &producer : producers)
+      producer.join();
+    consumer.join();
+
+    // Values of each producer are popped in the order they were pushed.
+    std::vector<int> last(n_producers, -1);
+    for (auto value : popped) {
+      auto &prev = last[value % n_producers];
+      verify(prev < value);
+      prev = value;
+    }
+    std::sort(popped.begin(), popped.end());
+    for (size_t i = 0; i < popped.size(); ++i)
+      verify(static_cast<int>(i) == popped[i]);
+    verify(queue.empty());
+  }
+});
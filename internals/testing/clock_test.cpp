@@ -0,0 +1,142 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto clock_test = test([]() {
+  const size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+  const size_t n_ops = 20000;
+
+  constexpr size_t n_atoms = 7;
+  constexpr size_t n_pairs = 3;
+
+  // The sum of `atoms` is kept at zero by swaps and the sum of each pair in
+  // `pairs` is kept non-negative by decrements that read the other atom of the
+  // pair without writing it, which requires read set validation on commit.
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+  std::unique_ptr<atom<int>[]> pairs(new atom<int>[2 * n_pairs]);
+
+  auto verify_invariants = [&]() {
+    atomically(assume_readonly, [&]() {
+      int sum = 0;
+      for (size_t i = 0; i < n_atoms; ++i)
+        sum += atoms[i];
+      verify(sum == 0);
+      for (size_t p = 0; p < n_pairs; ++p)
+        verify(0 <= pairs[2 * p] + pairs[2 * p + 1]);
+    });
+  };
+
+  const std::pair<clock_scheme, const char *> schemes[] = {
+      {clock_scheme::increment, "increment"},
+      {clock_scheme::pass_on_failure, "pass_on_failure"},
+      {clock_scheme::advance_on_abort, "advance_on_abort"}};
+
+  for (auto [scheme, name] : schemes) {
+    set_clock_scheme(scheme);
+
+    {
+      atom<int> x = 1, y = 0;
+      bool interfered = false;
+
+      atomically([&]() {
+        int x_value = x;
+        if (0 < x_value + y) {
+          if (!interfered) {
+            interfered = true;
+            std::thread([&]() {
+              atomically([&]() {
+                int y_value = y;
+                if (0 < x + y_value)
+                  y = y_value - 1;
+              });
+            }).join();
+          }
+          x = x_value - 1;
+        }
+      });
+
+      verify(interfered);
+      verify(0 <= x.unsafe_load() + y.unsafe_load());
+    }
+
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+      atomically([&]() {
+        for (size_t i = 0; i < n_atoms; ++i)
+          atoms[i] = 0;
+        for (size_t i = 0; i < 2 * n_pairs; ++i)
+          pairs[i] = 1;
+      });
+
+      atom<size_t> n_threads_stopped = 0;
+
+      auto start = std::chrono::high_resolution_clock::now();
+
+      std::vector<std::thread> threads;
+      for (size_t t = 0; t < n_threads; ++t)
+        threads.push_back(std::thread([&, t]() {
+          auto s = static_cast<uint32_t>(t);
+
+          for (size_t o = 0; o < n_ops; ++o) {
+            auto r = (s = dumpster::ranqd1(s)) >> 8;
+
+            if (r & 1) {
+              auto i = (r >> 1) % n_atoms;
+              auto j = i;
+              while (i == j)
+                j = (s = dumpster::ranqd1(s)) % n_atoms;
+
+              atomically(stack<128>, [&]() {
+                int &x = atoms[i].ref();
+                int &y = atoms[j].ref();
+                std::swap(--x, ++y);
+              });
+            } else {
+              auto p = (r >> 1) % n_pairs;
+              auto i = 2 * p + ((r >> 4) & 1);
+              auto j = 2 * p + !((r >> 4) & 1);
+
+              if (r & 0x60) {
+                atomically(stack<128>, [&]() {
+                  int x = pairs[i];
+                  if (0 < x + pairs[j])
+                    pairs[i] = x - 1;
+                });
+              } else {
+                atomically(stack<128>, [&]() { pairs[i].ref() += 1; });
+              }
+            }
+          }
+
+          atomically([&]() { n_threads_stopped.ref() += 1; });
+        }));
+
+      while (n_threads_stopped.unsafe_load() != n_threads)
+        verify_invariants();
+
+      for (auto &thread : threads)
+        thread.join();
+
+      std::chrono::duration<double> elapsed =
+          std::chrono::high_resolution_clock::now() - start;
+      fprintf(stderr,
+              "%s: %zu threads: %f Mcommits/s\n",
+              name,
+              n_threads,
+              n_ops * n_threads / elapsed.count() / 1000000.0);
+
+      verify_invariants();
+    }
+  }
+
+  set_clock_scheme(clock_scheme::increment);
+});
@@ -0,0 +1,216 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+using clock_type = std::chrono::high_resolution_clock;
+
+struct latencies {
+  std::vector<double> m_samples;
+
+  template <class Action> void time(Action &&action) {
+    auto start = clock_type::now();
+    action();
+    std::chrono::duration<double, std::micro> elapsed =
+        clock_type::now() - start;
+    m_samples.push_back(elapsed.count());
+  }
+
+  double percentile(double p) {
+    auto n = static_cast<size_t>(p * (m_samples.size() - 1));
+    std::nth_element(m_samples.begin(), m_samples.begin() + n, m_samples.end());
+    return m_samples[n];
+  }
+};
+
+template <class Workload>
+void report(const char *workload, const char *policy, Workload &&run) {
+  auto start = clock_type::now();
+  latencies all = run();
+  std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+  fprintf(stderr,
+          "%s: %s: %f Mops/s, p50 %.2f us, p99 %.2f us, p99.9 %.2f us\n",
+          workload,
+          policy,
+          all.m_samples.size() / elapsed.count() / 1000000.0,
+          all.percentile(0.5),
+          all.percentile(0.99),
+          all.percentile(0.999));
+}
+
+static latencies swaps(contention_policy policy) {
+  const size_t n_threads = std::max(std::thread::hardware_concurrency(), 2u);
+  const size_t n_ops = 50000;
+
+  constexpr size_t n_atoms = 7;
+
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+  atomically([&]() {
+    for (size_t i = 0; i < n_atoms; ++i)
+      atoms[i] = 0;
+  });
+
+  std::vector<latencies> per_thread(n_threads);
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < n_threads; ++t)
+    threads.push_back(std::thread([&, t]() {
+      auto s = static_cast<uint32_t>(t);
+
+      for (size_t o = 0; o < n_ops; ++o) {
+        auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+        auto j = i;
+        while (i == j)
+          j = (s = dumpster::ranqd1(s)) % n_atoms;
+
+        per_thread[t].time([&]() {
+          atomically(stack<128>, policy, [&]() {
+            int &x = atoms[i].ref();
+            int &y = atoms[j].ref();
+            std::swap(--x, ++y);
+          });
+        });
+      }
+    }));
+
+  for (auto &thread : threads)
+    thread.join();
+
+  verify(0 == atomically(assume_readonly, [&]() {
+           int sum = 0;
+           for (size_t i = 0; i < n_atoms; ++i)
+             sum += atoms[i];
+           return sum;
+         }));
+
+  latencies all;
+  for (auto &samples : per_thread)
+    all.m_samples.insert(
+        all.m_samples.end(), samples.m_samples.begin(), samples.m_samples.end());
+  return all;
+}
+
+static latencies dining(contention_policy policy) {
+  constexpr size_t n_to_eat = 20000;
+  constexpr size_t n_philosophers = 5;
+
+  struct fork {
+    fork() : on_table(true) {}
+    alignas(64) atom<bool> on_table;
+  };
+
+  fork forks[n_philosophers];
+
+  std::vector<latencies> per_thread(n_philosophers);
+
+  std::vector<std::thread> threads;
+  for (size_t philosopher = 0; philosopher < n_philosophers; ++philosopher)
+    threads.push_back(std::thread([&, philosopher]() {
+      auto &left = forks[philosopher];
+      auto &right = forks[(philosopher + 1) % n_philosophers];
+
+      for (size_t e = 0; e < n_to_eat; ++e) {
+        per_thread[philosopher].time([&]() {
+          atomically(stack<128>, policy, [&]() {
+            bool &left_on_table = left.on_table.ref();
+            bool &right_on_table = right.on_table.ref();
+            if (left_on_table && right_on_table)
+              left_on_table = right_on_table = false;
+            else
+              retry();
+          });
+        });
+
+        atomically(stack<128>, policy, [&]() {
+          left.on_table = right.on_table = true;
+        });
+      }
+    }));
+
+  for (auto &thread : threads)
+    thread.join();
+
+  latencies all;
+  for (auto &samples : per_thread)
+    all.m_samples.insert(
+        all.m_samples.end(), samples.m_samples.begin(), samples.m_samples.end());
+  return all;
+}
+
+auto contention_policy_test = test([]() {
+  const std::pair<contention_policy, const char *> policies[] = {
+      {contention_policy::immediate, "immediate"},
+      {contention_policy::backoff, "backoff"},
+      {contention_policy::scaled_spin, "scaled_spin"},
+      {contention_policy::spin, "spin"},
+      {contention_policy::priority, "priority"}};
+
+  for (auto [policy, name] : policies)
+    report("swaps", name, [&]() { return swaps(policy); });
+
+  for (auto [policy, name] : policies)
+    report("dining", name, [&]() { return dining(policy); });
+
+  {
+    constexpr size_t n_atoms = 64;
+    const size_t n_writers = 2;
+
+    std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+    atomically(heap(0), [&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        atoms[i] = 0;
+    });
+    atom<bool> done(false);
+
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < n_writers; ++t)
+      writers.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t + 1);
+        while (!atomically(assume_readonly, [&]() { return done.load(); })) {
+          auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+          atomically(stack<128>, contention_policy::priority, [&]() {
+            atoms[i].ref() += 1;
+          });
+        }
+      }));
+
+    // A long transaction yielding between reads completes against the stream
+    // of short writers once it is the oldest.
+    int n_attempts = 0;
+    atom<int> sum = 0;
+    atomically(heap(0), contention_policy::priority, [&]() {
+      n_attempts += 1;
+      int total = 0;
+      for (size_t i = 0; i < n_atoms; ++i) {
+        total += atoms[i];
+        std::this_thread::yield();
+      }
+      sum = total;
+    });
+
+    atomically([&]() { done = true; });
+    for (auto &writer : writers)
+      writer.join();
+
+    fprintf(stderr, "long transaction: %d attempts\n", n_attempts);
+    verify(n_attempts <= 10);
+  }
+
+  set_contention_policy(contention_policy::backoff);
+  {
+    atom<int> x = 0;
+    atomically([&]() { x.ref() += 1; });
+    verify(1 == x.unsafe_load());
+  }
+  set_contention_policy(contention_policy::immediate);
+});
@@ -0,0 +1,71 @@
+#include "trade_v1/counter.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto counter_test = test([]() {
+  {
+    counter<int> count(5);
+
+    verify(5 == count.load());
+    count.add(2);
+    verify(7 == count.load());
+
+    // Adds are seen by loads in the same transaction.
+    verify(10 == atomically([&]() {
+             count.add(3);
+             return count.load();
+           }));
+
+    verify(count.try_take(10));
+    verify(!count.try_take(1));
+    verify(0 == count.load());
+
+    // Adds are undone with the alternative.
+    verify(1 == or_else(
+                    [&]() {
+                      count.add(1);
+                      retry();
+                      return 0;
+                    },
+                    [&]() {
+                      count.add(1);
+                      return count.load();
+                    }));
+    verify(1 == count.unsafe_load());
+  }
+
+  {
+    counter<long, 4> count;
+
+    const long n_adds = 10000;
+    const size_t n_threads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+
+    // Takes block until the adds of other threads arrive and take from the
+    // shards of other threads.
+    std::thread taker([&]() {
+      for (long i = 0; i < n_adds * static_cast<long>(n_threads) / 3; ++i)
+        count.take(3);
+    });
+
+    std::vector<std::thread> adders;
+    for (size_t t = 0; t < n_threads; ++t)
+      adders.push_back(std::thread([&]() {
+        for (long i = 0; i < n_adds; ++i)
+          count.add(1);
+      }));
+
+    for (auto &adder : adders)
+      adder.join();
+    taker.join();
+
+    verify(n_adds * static_cast<long>(n_threads) % 3 == count.load());
+  }
+});
@@ -0,0 +1,109 @@
+#include "trade_v1/counter.hpp"
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto encounter_test = test([]() {
+  {
+    lock_group group;
+    atom<int, lock_group> x(group, 1), y(group, 2);
+    counter<int> count;
+
+    // Atoms under a lock held by the transaction itself can be read and
+    // written.
+    int n_attempts = 0;
+    verify(6 == atomically(encounter_locking, [&]() {
+             n_attempts += 1;
+             x = 3;
+             y.ref() += x;
+             count.add(1);
+             return y + count.load();
+           }));
+    verify(1 == n_attempts);
+    verify(3 == x.unsafe_load());
+    verify(5 == y.unsafe_load());
+    verify(1 == count.unsafe_load());
+  }
+
+  {
+    atom<int> x(0), y(0);
+
+    // Locks acquired in an alternative that retries are released, so other
+    // transactions can write the atom before the transaction commits.
+    int n_attempts = 0;
+    atomically(encounter_locking, [&]() {
+      n_attempts += 1;
+      or_else(
+          [&]() {
+            x = 1;
+            retry();
+          },
+          [&]() { y = 1; });
+      if (1 == n_attempts)
+        std::thread([&]() { atomically([&]() { x = 2; }); }).join();
+    });
+    verify(2 == x.unsafe_load());
+    verify(1 == y.unsafe_load());
+  }
+
+  {
+    constexpr size_t n_atoms = 7;
+    const int n_ops = 10000;
+    const size_t n_threads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+
+    std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+    for (size_t i = 0; i < n_atoms; ++i)
+      atomically([&]() { atoms[i] = 0; });
+    atom<int> turn(0);
+
+    // Transactions locking on encounter and on commit exclude each other and
+    // locks are released before blocking in `retry`.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t);
+        for (int o = 0; o < n_ops; ++o) {
+          auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+          auto j = i;
+          while (i == j)
+            j = (s = dumpster::ranqd1(s)) % n_atoms;
+
+          auto swap = [&]() {
+            int &x = atoms[i].ref();
+            int &y = atoms[j].ref();
+            std::swap(--x, ++y);
+          };
+          if (t % 2)
+            atomically(encounter_locking, swap);
+          else
+            atomically(swap);
+
+          if (0 == o % 1000)
+            atomically(encounter_locking, [&]() {
+              if (turn % static_cast<int>(n_threads) != static_cast<int>(t))
+                retry();
+              atoms[i].ref() += 1;
+              atoms[j].ref() -= 1;
+              turn.ref() += 1;
+            });
+        }
+      }));
+    for (auto &thread : threads)
+      thread.join();
+
+    int sum = 0;
+    for (size_t i = 0; i < n_atoms; ++i)
+      sum += atoms[i].unsafe_load();
+    verify(0 == sum);
+    verify(static_cast<int>(n_threads) * (n_ops / 1000) == turn.unsafe_load());
+  }
+});
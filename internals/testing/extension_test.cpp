@@ -0,0 +1,131 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+namespace {
+
+struct record {
+  int64_t m_first;
+  int64_t m_second;
+  char m_data[48];
+};
+
+template <class Action> void concurrently(Action &&action) {
+  std::thread(std::forward<Action>(action)).join();
+}
+
+} // namespace
+
+auto extension_test = test([]() {
+  {
+    atom<int> x(1), y(2), z(0);
+
+    // An atom written after the start is read without restarting when nothing
+    // read before has changed.
+    int n_attempts = 0;
+    verify(24 == atomically([&]() {
+             n_attempts += 1;
+             int sum = x;
+             z = 3;
+             if (1 == n_attempts)
+               concurrently([&]() { atomically([&]() { y = 20; }); });
+             return sum + y + z;
+           }));
+    verify(1 == n_attempts);
+    verify(3 == z.unsafe_load());
+
+    // The transaction restarts when an atom read before has changed.
+    n_attempts = 0;
+    verify(40 == atomically([&]() {
+             n_attempts += 1;
+             int sum = x;
+             if (1 == n_attempts)
+               concurrently([&]() {
+                 atomically([&]() {
+                   x = 10;
+                   y = 30;
+                 });
+               });
+             return sum + y;
+           }));
+    verify(2 == n_attempts);
+  }
+
+  {
+    atom<record> r(record{1, 2, ""});
+    atom<int> y(0);
+
+    // Members read before are checked too.
+    int n_attempts = 0;
+    verify(1 == atomically([&]() {
+             n_attempts += 1;
+             auto first = r.load(&record::m_first);
+             if (1 == n_attempts)
+               concurrently([&]() { atomically([&]() { y = 1; }); });
+             return first * y;
+           }));
+    verify(1 == n_attempts);
+
+    n_attempts = 0;
+    verify(9 == atomically([&]() {
+             n_attempts += 1;
+             auto first = r.load(&record::m_first);
+             if (1 == n_attempts)
+               concurrently([&]() {
+                 atomically([&]() { r = record{3, 3, ""}; });
+               });
+             return first * r.load(&record::m_second);
+           }));
+    verify(2 == n_attempts);
+  }
+
+  {
+    constexpr size_t n_atoms = 100;
+    const int n_transfers = 20000;
+    const size_t n_threads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+
+    std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+    atomically(heap(0), [&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        atoms[i] = 0;
+    });
+    atom<bool> done(false);
+
+    // Scans that extend their start time still see consistent sums.
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < n_threads; ++t)
+      threads.push_back(std::thread([&]() {
+        while (!atomically(assume_readonly, [&]() { return done.load(); }))
+          verify(0 == atomically(heap(0), [&]() {
+                   int sum = 0;
+                   for (size_t i = 0; i < n_atoms; ++i)
+                     sum += atoms[i];
+                   return sum;
+                 }));
+      }));
+
+    uint32_t s = 1;
+    for (int o = 0; o < n_transfers; ++o) {
+      auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+      auto j = (s = dumpster::ranqd1(s)) % n_atoms;
+      atomically([&]() {
+        atoms[i].ref() -= 1;
+        atoms[j].ref() += 1;
+      });
+    }
+    atomically([&]() { done = true; });
+
+    for (auto &thread : threads)
+      thread.join();
+  }
+});
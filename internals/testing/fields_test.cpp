@@ -0,0 +1,124 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+namespace {
+
+struct record {
+  int64_t m_balance;
+  int64_t m_count;
+  char m_data[240];
+};
+
+struct pair {
+  int32_t m_first;
+  int32_t m_second;
+};
+
+} // namespace
+
+auto fields_test = test([]() {
+  {
+    atom<record> r(record{1, 2, "data"});
+
+    // Written members are seen by later accesses to members and to the whole
+    // value.
+    verify(5 == atomically([&]() {
+             r.store(&record::m_balance, 3);
+             r.ref(&record::m_count) += 1;
+             verify(3 == r.load(&record::m_balance));
+             auto whole = r.load();
+             verify(3 == whole.m_count);
+             return whole.m_balance + r.load(&record::m_count) - 1;
+           }));
+    verify(3 == r.unsafe_load().m_balance);
+    verify(3 == r.unsafe_load().m_count);
+    verify('d' == r.unsafe_load().m_data[0]);
+
+    // Writes to the whole value are seen by accesses to members.
+    atomically([&]() {
+      r.store(&record::m_count, 10);
+      r.ref().m_balance += 10;
+      r.ref(&record::m_balance) += 1;
+      verify(10 == r.load(&record::m_count));
+    });
+    verify(14 == r.unsafe_load().m_balance);
+    verify(10 == r.unsafe_load().m_count);
+
+    // Writes to members are undone with the alternative.
+    verify(15 == or_else(
+                     [&]() {
+                       r.store(&record::m_balance, 0);
+                       retry();
+                       return int64_t(0);
+                     },
+                     [&]() { return ++r.ref(&record::m_balance); }));
+    verify(15 == r.unsafe_load().m_balance);
+
+    atomically(irrevocable, [&]() { r.ref(&record::m_count) += 1; });
+    verify(11 == r.unsafe_load().m_count);
+  }
+
+  {
+    atom<pair> p(pair{1, 2});
+    atomically([&]() { p.ref(&pair::m_second) += p.load(&pair::m_first); });
+    verify(3 == p.unsafe_load().m_second);
+  }
+
+  {
+    atom<record, versioned<>> r(record{1, 0, ""});
+
+    // Snapshot transactions read members of versioned atoms as of their start.
+    int n_attempts = 0;
+    auto balance = atomically(snapshot, [&]() {
+      n_attempts += 1;
+      if (1 == n_attempts)
+        std::thread([&]() {
+          atomically([&]() { r.store(&record::m_balance, 2); });
+        }).join();
+      return r.load(&record::m_balance);
+    });
+    verify(1 == n_attempts);
+    verify(1 == balance);
+  }
+
+  {
+    atom<record> r(record{0, 0, ""});
+
+    const int n_updates = 10000;
+    const size_t n_threads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+
+    // Concurrent updates of members and of the whole value are not lost.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        for (int i = 0; i < n_updates; ++i)
+          atomically([&]() {
+            if (t % 2)
+              r.ref(&record::m_balance) += 1;
+            else
+              r.store(&record::m_count, r.load(&record::m_count) + 1);
+            if (0 == i % 100)
+              r.ref().m_data[0] += 1;
+          });
+      }));
+    for (auto &thread : threads)
+      thread.join();
+
+    auto n_odd = static_cast<int64_t>(n_threads / 2);
+    auto n_even = static_cast<int64_t>(n_threads) - n_odd;
+    verify(n_odd * n_updates == r.unsafe_load().m_balance);
+    verify(n_even * n_updates == r.unsafe_load().m_count);
+    verify(static_cast<char>(n_threads * n_updates / 100) ==
+           r.unsafe_load().m_data[0]);
+  }
+});
@@ -0,0 +1,106 @@
+#include "trade_v1/hash_map_tm.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto hash_map_test = test([]() {
+  {
+    hash_map_tm<int, std::shared_ptr<int>> map(1);
+
+    verify(map.empty());
+    verify(map.insert(1, std::make_shared<int>(10)));
+    verify(!map.insert(1, std::make_shared<int>(20)));
+    verify(10 == **map.find(1));
+    verify(!map.find(2));
+
+    verify(map.update(
+        1, [](auto &p) { return std::make_shared<int>(*p + 1); }));
+    verify(!map.update(2, [](auto &p) { return p; }));
+    verify(11 == **map.find(1));
+
+    // Operations compose inside a transaction.
+    atomically([&]() {
+      if (auto value = map.find(1)) {
+        map.erase(1);
+        map.insert(2, *value);
+      }
+    });
+    verify(!map.find(1));
+    verify(11 == **map.find(2));
+    verify(1 == map.size());
+
+    verify(map.erase(2));
+    verify(!map.erase(2));
+    verify(map.empty());
+  }
+
+  {
+    hash_map_tm<int, int> map(1);
+
+    const int n_keys = 1000;
+    const size_t n_threads =
+        std::max(std::thread::hardware_concurrency(), 2u);
+
+    // Concurrent inserts and erases while the table grows from one bucket.
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        for (int i = 0; i < n_keys; ++i) {
+          map.insert(i, i);
+          if (static_cast<size_t>(i) % n_threads == t)
+            map.erase(i + n_keys);
+          map.insert(i + n_keys, i);
+          map.update(i, [](int value) { return value + 1; });
+        }
+      }));
+
+    for (auto &thread : threads)
+      thread.join();
+
+    verify(2 * n_keys == static_cast<int>(map.size()));
+    for (int i = 0; i < n_keys; ++i) {
+      verify(i + static_cast<int>(n_threads) == map.find(i).value());
+      verify(i == map.find(i + n_keys).value());
+    }
+
+    map.reserve(100000);
+    verify(2 * n_keys == static_cast<int>(map.size()));
+    verify(0 == map.find(n_keys).value());
+  }
+
+  {
+    hash_map_tm<int, int> map(1);
+
+    // A map filled inside a single transaction grows after the commit.
+    const int n_keys = 1000;
+    atomically(heap(0), [&]() {
+      for (int i = 0; i < n_keys; ++i)
+        map.insert(i, i);
+      verify(1 == map.bucket_count());
+    });
+    verify(n_keys <= static_cast<int>(2 * map.bucket_count()));
+    for (int i = 0; i < n_keys; ++i)
+      verify(i == map.find(i).value());
+
+    // Growth registered by an undone alternative is dropped.
+    hash_map_tm<int, int> other(1);
+    atomically(heap(0), [&]() {
+      or_else(
+          [&]() {
+            for (int i = 0; i < n_keys; ++i)
+              other.insert(i, i);
+            retry();
+          },
+          [&]() {});
+    });
+    verify(other.empty());
+    verify(1 == other.bucket_count());
+  }
+});
@@ -0,0 +1,98 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <thread>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto hot_spot_test = test([]() {
+  reset_hot_spots();
+
+  lock_group group;
+  atom<int, lock_group> x(group, 0), y(group, 0);
+  atom<int> z = 0, sum = 0;
+
+  // Reads `read`, lets another thread commit writes to `written`, and then
+  // writes, which makes the first attempt fail validation on `read`.
+  auto conflict = [&](auto &read, auto &...written) {
+    bool first = true;
+    atomically([&]() {
+      int value = read;
+      if (first) {
+        first = false;
+        std::thread([&]() {
+          atomically([&]() { ((written.ref() += 1), ...); });
+        }).join();
+      }
+      sum = value;
+    });
+  };
+
+  conflict(x, y);
+  conflict(x, x);
+  conflict(z, z);
+
+  // Every atom written under a shared lock counts as written.
+  conflict(x, x, y);
+  conflict(y, x, y);
+
+  dump_hot_spots(stderr, 5);
+
+  auto hot_spots = get_hot_spots();
+
+  if (!TRADE_V1_PROFILE) {
+    verify(hot_spots.empty());
+    return;
+  }
+
+  auto find = [&](const void *atom) {
+    return std::find_if(hot_spots.begin(),
+                        hot_spots.end(),
+                        [&](auto &hot_spot) { return hot_spot.atom == atom; });
+  };
+
+  auto x_spot = find(&x);
+  verify(x_spot != hot_spots.end());
+  verify(2 == x_spot->n_true_conflicts);
+  verify(1 == x_spot->n_collisions);
+  verify(-1 == x_spot->lock_index);
+
+  auto y_spot = find(&y);
+  verify(y_spot != hot_spots.end());
+  verify(1 == y_spot->n_true_conflicts);
+  verify(0 == y_spot->n_collisions);
+
+  auto z_spot = find(&z);
+  verify(z_spot != hot_spots.end());
+  verify(1 == z_spot->n_true_conflicts);
+  verify(0 == z_spot->n_collisions);
+  verify(static_cast<ptrdiff_t>(lock_index_of(z)) == z_spot->lock_index);
+
+  verify(hot_spots.front().atom == static_cast<const void *>(&x));
+
+  reset_hot_spots();
+  verify(get_hot_spots().empty());
+
+  {
+    // Conflicts are buffered per thread.  More conflicts than fit in a buffer
+    // and those of threads that have exited are all reported.
+    atom<int> w = 0;
+    const size_t n_threads = 2, n_conflicts = 1000;
+
+    for (size_t t = 0; t < n_threads; ++t)
+      std::thread([&]() {
+        for (size_t i = 0; i < n_conflicts; ++i)
+          conflict(w, w);
+      }).join();
+
+    hot_spots = get_hot_spots();
+
+    auto w_spot = find(&w);
+    verify(w_spot != hot_spots.end());
+    verify(n_threads * n_conflicts == w_spot->n_true_conflicts);
+    verify(0 == w_spot->n_collisions);
+  }
+});
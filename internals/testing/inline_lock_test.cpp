@@ -0,0 +1,122 @@
+#include "trade_v1/trade.hpp"
+
+#include "polyfill_v1/memory.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto inline_lock_test = test([]() {
+  static_assert(sizeof(atom<int>) < sizeof(atom<int, inline_lock>));
+
+  {
+    atom<int, inline_lock> x = 1;
+    atom<int> y = 2;
+    atom<std::shared_ptr<int>, inline_lock> p(std::make_shared<int>(3));
+
+    struct TriviallyCopyable {
+      int x;
+      double y;
+      size_t z;
+    };
+
+    atom<TriviallyCopyable, inline_lock> tc({4, 0.5, 6});
+
+    verify(1 == x.unsafe_load());
+    verify(3 == *p.unsafe_load());
+    verify(4 == tc.unsafe_load().x);
+
+    atomically([&]() {
+      int x_value = x;
+      x = y.load();
+      y = x_value;
+      *p.ref() += 1;
+      tc.ref().y += 1;
+    });
+
+    verify(2 == x.unsafe_load());
+    verify(1 == y.unsafe_load());
+    verify(4 == *p.unsafe_load());
+    verify(1.5 == tc.unsafe_load().y);
+
+    verify(3 == atomically(assume_readonly, [&]() { return x + y; }));
+  }
+
+  {
+    atom<int, inline_lock> ping = 0;
+    atom<int> pong = 0;
+
+    const int n_rounds = 1000;
+
+    std::thread other([&]() {
+      for (int i = 0; i < n_rounds; ++i)
+        atomically([&]() {
+          if (ping != i + 1)
+            retry();
+          pong = i + 1;
+        });
+    });
+
+    for (int i = 0; i < n_rounds; ++i)
+      atomically([&]() {
+        if (pong != i)
+          retry();
+        ping = i + 1;
+      });
+
+    other.join();
+
+    verify(n_rounds == pong.unsafe_load());
+  }
+
+  {
+    const size_t n_threads = std::max(std::thread::hardware_concurrency(), 2u);
+    const size_t n_ops = 20000;
+
+    constexpr size_t n_atoms = 6;
+
+    std::unique_ptr<atom<int>[]> hashed(new atom<int>[n_atoms / 2]);
+    std::unique_ptr<atom<int, inline_lock>[]> inlined(
+        new atom<int, inline_lock>[n_atoms / 2]);
+
+    auto atom_at = [&](size_t i) -> int & {
+      return i & 1 ? hashed[i / 2].ref() : inlined[i / 2].ref();
+    };
+
+    atomically([&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        atom_at(i) = 0;
+    });
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t);
+
+        for (size_t o = 0; o < n_ops; ++o) {
+          auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+          auto j = i;
+          while (i == j)
+            j = (s = dumpster::ranqd1(s)) % n_atoms;
+
+          atomically([&]() { std::swap(--atom_at(i), ++atom_at(j)); });
+        }
+      }));
+
+    for (auto &thread : threads)
+      thread.join();
+
+    verify(0 == atomically([&]() {
+             int sum = 0;
+             for (size_t i = 0; i < n_atoms; ++i)
+               sum += i & 1 ? hashed[i / 2].load() : inlined[i / 2].load();
+             return sum;
+           }));
+  }
+});
@@ -0,0 +1,150 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto irrevocable_test = test([]() {
+  constexpr size_t n_atoms = 10000;
+
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+
+  atomically(heap(0), [&]() {
+    for (size_t i = 0; i < n_atoms; ++i)
+      atoms[i] = 0;
+  });
+
+  {
+    atom<int> x = 1, y = 2;
+    int n_invocations = 0;
+
+    int sum = atomically(irrevocable, [&]() {
+      n_invocations += 1;
+      x = atomically([&]() { return x + y; });
+      y.ref() += 1;
+      return x + y;
+    });
+
+    verify(1 == n_invocations);
+    verify(6 == sum);
+  }
+
+  {
+    atom<bool> flag = false;
+    int n_invocations = 0;
+
+    std::thread setter([&]() { atomically([&]() { flag = true; }); });
+
+    atomically(irrevocable, [&]() {
+      n_invocations += 1;
+      if (!flag)
+        retry();
+    });
+
+    setter.join();
+
+    verify(1 <= n_invocations);
+  }
+
+  {
+    atom<int> x = 1;
+
+    int value = atomically(irrevocable, [&]() {
+      return or_else(
+          [&]() {
+            x = 2;
+            retry();
+            return 0;
+          },
+          [&]() { return x.load(); });
+    });
+
+    verify(1 == value);
+    verify(1 == atomically([&]() { return x.load(); }));
+  }
+
+#if TRADE_V1_EXCEPTIONS
+  {
+    bool thrown = false;
+    try {
+      atomically(irrevocable, [&]() {
+        atoms[0] = 1;
+        throw std::runtime_error("user");
+      });
+    } catch (std::runtime_error &) {
+      thrown = true;
+    }
+    verify(thrown);
+    verify(0 == atomically([&]() { return atoms[0].load(); }));
+    atomically(irrevocable, [&]() { verify(0 == atoms[0]); });
+  }
+#endif
+
+  // Short writers keep swapping units between atoms while long transactions
+  // update every atom, which would rarely succeed optimistically.
+  const size_t n_writers = std::max(std::thread::hardware_concurrency(), 2u);
+
+  auto batches = [&](auto config, const char *name) {
+    atom<bool> stop = false;
+
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < n_writers; ++t)
+      writers.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t);
+        while (!stop.unsafe_load()) {
+          auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+          auto j = (s = dumpster::ranqd1(s)) % n_atoms;
+          atomically(stack<128>, [&]() {
+            atoms[i].ref() -= 1;
+            atoms[j].ref() += 1;
+          });
+        }
+      }));
+
+    double max_latency = 0;
+    for (int b = 0; b < 20; ++b) {
+      int n_invocations = 0;
+      auto start = std::chrono::high_resolution_clock::now();
+      int sum = atomically(config, [&]() {
+        n_invocations += 1;
+        int sum = 0;
+        for (size_t i = 0; i < n_atoms; ++i)
+          sum += atoms[i].ref() += 1;
+        return sum;
+      });
+      std::chrono::duration<double, std::milli> elapsed =
+          std::chrono::high_resolution_clock::now() - start;
+      max_latency = std::max(max_latency, elapsed.count());
+
+      verify(static_cast<int>(n_atoms) * (b + 1) == sum);
+      if (std::is_same_v<decltype(config), irrevocable_t>)
+        verify(1 == n_invocations);
+    }
+
+    atomically([&]() { stop = true; });
+    for (auto &writer : writers)
+      writer.join();
+
+    atomically(heap(0), [&]() {
+      for (size_t i = 0; i < n_atoms; ++i)
+        atoms[i] = 0;
+    });
+
+    fprintf(stderr, "%s: max batch latency %f ms\n", name, max_latency);
+  };
+
+  batches(irrevocable, "irrevocable");
+
+  set_escalation_threshold(4);
+  batches(heap(n_atoms * 64), "escalate after 4 aborts");
+  set_escalation_threshold(0);
+});
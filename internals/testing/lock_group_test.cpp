@@ -0,0 +1,132 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+struct hashed_account {
+  atom<int> balance = 0;
+  atom<int> n_transfers = 0;
+  atom<int> last_amount = 0;
+};
+
+struct grouped_account {
+  lock_group group;
+  atom<int, lock_group> balance{group, 0};
+  atom<int, lock_group> n_transfers{group, 0};
+  atom<int, lock_group> last_amount{group, 0};
+};
+
+template <class Account> void transfer_test(const char *name) {
+  const size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+  const size_t n_ops = 20000;
+
+  constexpr size_t n_accounts = 8;
+
+  std::unique_ptr<Account[]> accounts(new Account[n_accounts]);
+
+  size_t n_transfers = 0;
+
+  for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    reset_stats();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t);
+
+        for (size_t o = 0; o < n_ops; ++o) {
+          auto i = (s = dumpster::ranqd1(s)) % n_accounts;
+          auto j = i;
+          while (i == j)
+            j = (s = dumpster::ranqd1(s)) % n_accounts;
+          int amount = (s = dumpster::ranqd1(s)) % 100;
+
+          atomically([&]() {
+            auto &from = accounts[i];
+            auto &to = accounts[j];
+            from.balance.ref() -= amount;
+            from.n_transfers.ref() += 1;
+            from.last_amount = -amount;
+            to.balance.ref() += amount;
+            to.n_transfers.ref() += 1;
+            to.last_amount = amount;
+          });
+        }
+      }));
+
+    for (auto &thread : threads)
+      thread.join();
+
+    n_transfers += n_ops * n_threads;
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    // Acquisitions are counted only with `TRADE_V1_STATS` and include those
+    // of aborted commits.
+    auto s = get_stats();
+    fprintf(stderr,
+            "%s: %f lock acquisitions per commit: %zu threads: %f Mops/s\n",
+            name,
+            TRADE_V1_STATS && s.n_commits
+                ? double(s.n_lock_acquisitions) / s.n_commits
+                : NAN,
+            n_threads,
+            n_ops * n_threads / elapsed.count() / 1000000.0);
+  }
+
+  atomically(assume_readonly, [&]() {
+    int balance = 0, n_transfers_total = 0;
+    for (size_t i = 0; i < n_accounts; ++i) {
+      balance += accounts[i].balance;
+      n_transfers_total += accounts[i].n_transfers;
+    }
+    verify(0 == balance);
+    verify(static_cast<int>(2 * n_transfers) == n_transfers_total);
+  });
+}
+
+auto lock_group_test = test([]() {
+  {
+    lock_group group;
+    atom<int, lock_group> x(group, 1), y(group);
+    atom<int> z = 3;
+
+    atomically([&]() {
+      y = x + z;
+      z = y - 1;
+    });
+
+    verify(4 == y.unsafe_load());
+    verify(3 == z.unsafe_load());
+  }
+
+  {
+    grouped_account account;
+
+    std::thread waiter([&]() {
+      atomically([&]() {
+        if (account.n_transfers < 1 || account.balance < 10)
+          retry();
+      });
+    });
+
+    atomically([&]() { account.n_transfers = 1; });
+    atomically([&]() { account.balance = 10; });
+
+    waiter.join();
+  }
+
+  transfer_test<hashed_account>("hashed");
+  transfer_test<grouped_account>("grouped");
+});
@@ -0,0 +1,115 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+#define STRINGIFY(x) #x
+#define STRING(x) STRINGIFY(x)
+
+#ifdef TRADE_V1_LOCK_TABLE_SIZE
+#define LOCK_TABLE_SIZE STRING(TRADE_V1_LOCK_TABLE_SIZE)
+#else
+#define LOCK_TABLE_SIZE "default"
+#endif
+
+template <class Atoms>
+static double collision_rate(size_t n, Atoms &&atom_at) {
+  std::unordered_set<size_t> indices;
+  for (size_t i = 0; i < n; ++i)
+    indices.insert(lock_index_of(atom_at(i)));
+  return 1.0 - static_cast<double>(indices.size()) / n;
+}
+
+auto lock_table_test = test([]() {
+  fprintf(stderr,
+          "hash %s, table size %s, align %s\n",
+          STRING(TRADE_V1_LOCK_HASH),
+          LOCK_TABLE_SIZE,
+          STRING(TRADE_V1_LOCK_ALIGN));
+
+  {
+    atom<int> an_atom;
+    verify(lock_index_of(an_atom) == lock_index_of(an_atom));
+  }
+
+  for (size_t n : {1024, 16384, 65536}) {
+    {
+      std::unique_ptr<atom<int>[]> atoms(new atom<int>[n]);
+      fprintf(stderr,
+              "%zu contiguous atoms: %f collision rate\n",
+              n,
+              collision_rate(n, [&](size_t i) -> auto & { return atoms[i]; }));
+    }
+
+    {
+      struct record {
+        atom<int> m_atom;
+        char m_other_fields[60];
+      };
+      std::unique_ptr<record[]> records(new record[n]);
+      fprintf(stderr,
+              "%zu 64 byte records: %f collision rate\n",
+              n,
+              collision_rate(n, [&](size_t i) -> auto & {
+                return records[i].m_atom;
+              }));
+    }
+
+    {
+      std::vector<std::unique_ptr<atom<long>>> atoms;
+      for (size_t i = 0; i < n; ++i)
+        atoms.emplace_back(new atom<long>());
+      fprintf(stderr,
+              "%zu heap allocated atoms: %f collision rate\n",
+              n,
+              collision_rate(n, [&](size_t i) -> auto & { return *atoms[i]; }));
+    }
+  }
+
+  // Threads increment distinct adjacent atoms so any slowdown with more
+  // threads is due to sharing of locks or cache lines.
+  const size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+  const size_t n_ops = 100000;
+
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[max_threads]);
+  std::vector<size_t> n_sweeps(max_threads);
+  for (size_t t = 0; t < max_threads; ++t)
+    atomically([&]() { atoms[t] = 0; });
+
+  for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        for (size_t o = 0; o < n_ops; ++o)
+          atomically(stack<64>, [&]() { atoms[t].ref() += 1; });
+      }));
+
+    for (auto &thread : threads)
+      thread.join();
+
+    for (size_t t = 0; t < n_threads; ++t)
+      n_sweeps[t] += 1;
+
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    fprintf(stderr,
+            "%zu threads on adjacent atoms: %f Mops/s\n",
+            n_threads,
+            n_ops * n_threads / elapsed.count() / 1000000.0);
+  }
+
+  for (size_t t = 0; t < max_threads; ++t)
+    verify(atoms[t].unsafe_load() == static_cast<int>(n_ops * n_sweeps[t]));
+});
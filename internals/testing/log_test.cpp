@@ -0,0 +1,76 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+static std::atomic<size_t> s_n_allocations = 0;
+
+void *operator new(size_t size) {
+  s_n_allocations += 1;
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+#if TRADE_V1_EXCEPTIONS
+  throw std::bad_alloc();
+#else
+  std::abort();
+#endif
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+auto log_test = test([]() {
+  constexpr size_t n_atoms = 10000;
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+  atomically(heap(0), [&]() {
+    for (size_t i = 0; i < n_atoms; ++i)
+      atoms[i] = 0;
+  });
+
+  auto update = [&](auto config) {
+    size_t n_attempts = 0;
+    atomically(config, [&]() {
+      n_attempts += 1;
+      for (size_t i = 0; i < n_atoms; ++i)
+        atoms[i].ref() += 1;
+    });
+    return n_attempts;
+  };
+
+  // Logs grow without restarting the transaction.
+  verify(1 == update(stack<1024>));
+  verify(1 == update(heap(16)));
+  verify(1 == update(irrevocable));
+
+  // Once the chunks of the thread are large enough, transactions do not
+  // allocate.
+  for (int round = 0; round < 2; ++round) {
+    auto n_allocations = s_n_allocations.load();
+    verify(1 == update(stack<1024>));
+    verify(1 == update(heap(16)));
+    verify(1 == update(irrevocable));
+    verify(n_allocations == s_n_allocations.load());
+  }
+
+  // Undo records of `or_else` also spill.
+  or_else(
+      [&]() {
+        for (size_t i = 0; i < n_atoms; ++i)
+          atoms[i] = -1;
+        retry();
+      },
+      [&]() {});
+
+  atomically(assume_readonly, [&]() {
+    for (size_t i = 0; i < n_atoms; ++i)
+      verify(9 == atoms[i]);
+  });
+});
@@ -0,0 +1,99 @@
+#include "testing/queue_tm.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace testing_v1;
+using namespace trade_v1;
+using namespace testing;
+
+auto or_else_test = test([]() {
+  atom<int> x = 1, y = 0;
+  atom<std::shared_ptr<int>> p = std::make_shared<int>(1);
+
+  verify(12 == atomically([&]() {
+           x = 10;
+           return or_else(
+               [&]() {
+                 x = 20;
+                 y.ref() += 5;
+                 p = std::make_shared<int>(2);
+                 retry();
+                 return 0;
+               },
+               [&]() {
+                 auto &value = p.ref();
+                 value = std::make_shared<int>(*value + 1);
+                 return x + y + *p.load();
+               });
+         }));
+
+  verify(10 == x.unsafe_load());
+  verify(0 == y.unsafe_load());
+  verify(2 == *p.unsafe_load());
+
+  // Writes of a nested alternative that completes are undone along with the
+  // enclosing alternative when it retries.
+  verify(3 == atomically([&]() {
+           return or_else(
+               [&]() {
+                 or_else([&]() { retry(); }, [&]() { y = 1; });
+                 x = y + 1;
+                 retry();
+                 return 0;
+               },
+               [&]() { return or_else([&]() { return 3; }, [&]() { return 4; }); });
+         }));
+
+  verify(10 == x.unsafe_load());
+  verify(0 == y.unsafe_load());
+
+  verify(2 == or_else(
+                  [&]() {
+                    if (x == 10)
+                      retry();
+                    return 1;
+                  },
+                  [&]() { return 2; }));
+
+  {
+    int values[2] = {0, 0};
+
+    // Results returned by reference refer to the returned object.
+    int &first = or_else([&]() -> int & { return values[0]; },
+                         [&]() -> int & { return values[1]; });
+    verify(&values[0] == &first);
+
+    int &second = or_else(
+        [&]() -> int & {
+          retry();
+          return values[0];
+        },
+        [&]() -> int & { return values[1]; });
+    verify(&values[1] == &second);
+  }
+
+  {
+    queue_tm<int> queues[2];
+
+    std::thread consumer([&]() {
+      int sum = 0;
+      for (int i = 0; i < 4; ++i)
+        sum += or_else([&]() { return queues[0].pop_front(); },
+                       [&]() { return queues[1].pop_front(); });
+      verify(1 + 2 + 10 + 20 == sum);
+    });
+
+    queues[1].push_back(10);
+    queues[0].push_back(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queues[1].push_back(20);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    queues[0].push_back(2);
+
+    consumer.join();
+  }
+});
@@ -0,0 +1,76 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto read_only_test = test([]() {
+  const size_t max_threads = std::max(std::thread::hardware_concurrency(), 2u);
+  const size_t n_ops = 100000;
+
+  constexpr size_t n_atoms = 8;
+
+  std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+
+  atomically([&]() {
+    for (size_t i = 0; i < n_atoms; ++i)
+      atoms[i] = 0;
+  });
+
+  // One in 64 transactions swaps a unit between two atoms and the rest check
+  // that the sum of atoms is zero.  Without a fast path for transactions that
+  // turn out to be read-only, readers would increment the shared clock on every
+  // commit and run much slower than with `assume_readonly`.
+  auto mixed = [&](auto config, const char *name) {
+    for (size_t n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+      auto start = std::chrono::high_resolution_clock::now();
+
+      std::vector<std::thread> threads;
+      for (size_t t = 0; t < n_threads; ++t)
+        threads.push_back(std::thread([&, t]() {
+          auto s = static_cast<uint32_t>(t);
+
+          for (size_t o = 0; o < n_ops; ++o) {
+            auto r = (s = dumpster::ranqd1(s)) >> 8;
+            if (r % 64 == 0) {
+              auto i = (r >> 6) % n_atoms;
+              auto j = (i + 1 + (r >> 12) % (n_atoms - 1)) % n_atoms;
+              atomically([&]() {
+                atoms[i].ref() -= 1;
+                atoms[j].ref() += 1;
+              });
+            } else {
+              verify(0 == atomically(config, [&]() {
+                       int sum = 0;
+                       for (size_t i = 0; i < n_atoms; ++i)
+                         sum += atoms[i];
+                       return sum;
+                     }));
+            }
+          }
+        }));
+
+      for (auto &thread : threads)
+        thread.join();
+
+      std::chrono::duration<double> elapsed =
+          std::chrono::high_resolution_clock::now() - start;
+      fprintf(stderr,
+              "%s: %zu threads: %f Mtxs/s\n",
+              name,
+              n_threads,
+              n_ops * n_threads / elapsed.count() / 1000000.0);
+    }
+  };
+
+  mixed(stack<1024>, "stack");
+  mixed(assume_readonly, "assume_readonly");
+});
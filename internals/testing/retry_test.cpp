@@ -3,6 +3,8 @@
 #include "testing_v1/test.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <thread>
 
 using namespace testing_v1;
@@ -33,4 +35,34 @@ auto retry_test = test([]() {
 
   for (auto &thread : threads)
     thread.join();
+
+  {
+    // A retry that finds the lock of a read atom held waits for the holder
+    // to commit.
+    atom<int> x = 0;
+    std::atomic<bool> read(false), held(false);
+
+    std::thread holder([&]() {
+      while (!read)
+        std::this_thread::yield();
+      atomically(encounter_locking, [&]() {
+        x = 1;
+        held = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      });
+    });
+
+    verify(1 == atomically([&]() {
+             int v = x;
+             if (!v) {
+               read = true;
+               while (!held)
+                 std::this_thread::yield();
+               retry();
+             }
+             return v;
+           }));
+
+    holder.join();
+  }
 });
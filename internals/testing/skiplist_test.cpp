@@ -0,0 +1,90 @@
+#include "trade_v1/skiplist_tm.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto skiplist_test = test([]() {
+  {
+    skiplist_tm<int, std::string> map;
+
+    verify(map.empty());
+    for (int key : {5, 1, 9, 3, 7})
+      verify(map.insert(key, std::to_string(key)));
+    verify(!map.insert(3, "x"));
+    verify("3" == map.find(3).value());
+    verify(!map.find(4));
+
+    verify(5 == map.lower_bound(4)->first);
+    verify(!map.lower_bound(10));
+
+    std::vector<int> keys;
+    map.scan(2, [&](int key, auto &) {
+      keys.push_back(key);
+      return key < 7;
+    });
+    verify((std::vector<int>{3, 5, 7} == keys));
+
+    // Operations compose inside a transaction.
+    atomically([&]() {
+      auto min = map.pop_min();
+      map.erase(9);
+      map.insert(min.first + 10, min.second);
+    });
+    verify(!map.find(1));
+    verify(!map.find(9));
+    verify("1" == map.find(11).value());
+
+    verify(map.erase(5));
+    verify(!map.erase(5));
+
+    keys.clear();
+    while (auto min = map.try_pop_min())
+      keys.push_back(min->first);
+    verify((std::vector<int>{3, 7, 11} == keys));
+    verify(map.empty());
+  }
+
+  {
+    skiplist_tm<int, int> map;
+
+    const int n_keys = 1000;
+    const size_t n_producers =
+        std::max(std::thread::hardware_concurrency() / 2, 1u);
+
+    std::vector<std::thread> producers;
+    for (size_t t = 0; t < n_producers; ++t)
+      producers.push_back(std::thread([&, t]() {
+        for (int i = 0; i < n_keys; ++i)
+          map.insert(static_cast<int>(i * n_producers + t), i);
+      }));
+
+    std::vector<int> popped;
+    std::thread consumer([&]() {
+      for (size_t i = 0; i < n_keys * n_producers; ++i)
+        popped.push_back(map.pop_min().first);
+    });
+
+    for (auto &producer : producers)
+      producer.join();
+    consumer.join();
+
+    std::sort(popped.begin(), popped.end());
+    for (size_t i = 0; i < popped.size(); ++i)
+      verify(static_cast<int>(i) == popped[i]);
+    verify(map.empty());
+  }
+
+  {
+    // Destroying a long list does not recurse through the nodes.
+    skiplist_tm<int, int> map;
+    for (int i = 0; i < 200000; ++i)
+      map.insert(i, i);
+  }
+});
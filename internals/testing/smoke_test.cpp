@@ -76,11 +76,8 @@ auto smoke_test = test([]() {
   }
 
   {
-    try {
-      verify(p.unsafe_load() !=
-             atomically(stack<1>, [&]() { return p.load(); }));
-    } catch (const std::bad_alloc &) {
-    }
+    // A log that does not fit on the stack spills to the heap.
+    verify(p.unsafe_load() == atomically(stack<1>, [&]() { return p.load(); }));
   }
 
   {
@@ -0,0 +1,108 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+auto snapshot_test = test([]() {
+  {
+    atom<int, versioned<>> x(1);
+    atom<int, versioned<inline_lock>> y(2);
+    lock_group group;
+    atom<int, versioned<lock_group, 2>> z(group, 3);
+
+    // Writes committed after the start of a snapshot transaction are not seen
+    // and do not abort the transaction.
+    int n_attempts = 0;
+    auto sum = atomically(snapshot, [&]() {
+      n_attempts += 1;
+      int sum = x;
+      if (1 == n_attempts)
+        std::thread([&]() {
+          atomically([&]() {
+            x = 10;
+            y = 20;
+            z = 30;
+          });
+        }).join();
+      return sum + x + y + z;
+    });
+    verify(1 == n_attempts);
+    verify(1 + 1 + 2 + 3 == sum);
+    verify(60 == atomically(snapshot, [&]() { return x + y + z; }));
+
+    // A snapshot transaction aborts when the versions it needs are no longer
+    // retained.
+    n_attempts = 0;
+    sum = atomically(snapshot, [&]() {
+      n_attempts += 1;
+      if (1 == n_attempts)
+        std::thread([&]() {
+          for (int i = 0; i < 3; ++i)
+            atomically([&]() { z = z + 1; });
+        }).join();
+      return z.load();
+    });
+    verify(2 == n_attempts);
+    verify(33 == sum);
+
+    // An ordinary read-only transaction aborts on a newer version.
+    n_attempts = 0;
+    sum = atomically(assume_readonly, [&]() {
+      n_attempts += 1;
+      if (1 == n_attempts)
+        std::thread([&]() { atomically([&]() { x = 11; }); }).join();
+      return x.load();
+    });
+    verify(2 == n_attempts);
+    verify(11 == sum);
+
+    // Writing restarts the transaction as an ordinary transaction.
+    atomically(snapshot, [&]() { x = x + 1; });
+    verify(12 == x.unsafe_load());
+  }
+
+  {
+    constexpr int n_atoms = 256, initial = 100;
+    std::vector<atom<int, versioned<>>> atoms(n_atoms);
+    for (auto &atom : atoms)
+      atomically([&]() { atom = initial; });
+
+    std::atomic<bool> done = false;
+    const size_t n_writers =
+        std::max(std::thread::hardware_concurrency() / 2, 1u);
+
+    std::vector<std::thread> writers;
+    for (size_t t = 0; t < n_writers; ++t)
+      writers.push_back(std::thread([&, t]() {
+        auto seed = static_cast<uint32_t>(t + 1);
+        while (!done) {
+          seed = seed * 1664525 + 1013904223;
+          auto i = (seed >> 8) % n_atoms, j = (seed >> 16) % n_atoms;
+          atomically([&]() {
+            atoms[i] = atoms[i] - 1;
+            atoms[j] = atoms[j] + 1;
+          });
+        }
+      }));
+
+    // Every scan sees a consistent sum.
+    for (int i = 0; i < 1000; ++i)
+      verify(n_atoms * initial == atomically(snapshot, [&]() {
+               int sum = 0;
+               for (auto &atom : atoms)
+                 sum += atom;
+               return sum;
+             }));
+
+    done = true;
+    for (auto &writer : writers)
+      writer.join();
+  }
+});
@@ -0,0 +1,181 @@
+#include "trade_v1/trade.hpp"
+
+#include "testing_v1/test.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace testing_v1;
+using namespace trade_v1;
+
+static uint64_t n_aborts(const stats &s) {
+  uint64_t n = 0;
+  for (auto n_reason : s.n_aborts)
+    n += n_reason;
+  return n;
+}
+
+static uint64_t n_aborts(const stats &s, abort_reason reason) {
+  return s.n_aborts[static_cast<size_t>(reason)];
+}
+
+auto stats_test = test([]() {
+  reset_stats();
+
+  atom<int> x = 0, y = 0;
+
+  atomically([&]() { x = 1; });
+
+  atomically(assume_readonly, [&]() { y = x + 1; });
+
+  atomically(heap(1), [&]() { x = y + 1; });
+
+#if TRADE_V1_EXCEPTIONS
+  try {
+    atomically([&]() {
+      if (x == 3)
+        throw 1;
+    });
+  } catch (int) {
+  }
+#endif
+
+  {
+    atom<bool> ready = false;
+
+    std::thread waiter([&]() {
+      atomically([&]() {
+        if (!ready)
+          retry();
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    atomically([&]() { ready = true; });
+
+    waiter.join();
+  }
+
+  {
+    const size_t n_threads = std::max(std::thread::hardware_concurrency(), 2u);
+    const size_t n_ops = 20000;
+
+    constexpr size_t n_atoms = 4;
+
+    std::unique_ptr<atom<int>[]> atoms(new atom<int>[n_atoms]);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_threads; ++t)
+      threads.push_back(std::thread([&, t]() {
+        auto s = static_cast<uint32_t>(t);
+
+        for (size_t o = 0; o < n_ops; ++o) {
+          auto i = (s = dumpster::ranqd1(s)) % n_atoms;
+          auto j = i;
+          while (i == j)
+            j = (s = dumpster::ranqd1(s)) % n_atoms;
+
+          atomically([&]() { std::swap(--atoms[i].ref(), ++atoms[j].ref()); });
+        }
+      }));
+
+    for (auto &thread : threads)
+      thread.join();
+  }
+
+  auto s = get_stats();
+
+  fprintf(stderr,
+          "starts: %llu commits: %llu aborts: %llu\n",
+          static_cast<unsigned long long>(s.n_starts),
+          static_cast<unsigned long long>(s.n_commits),
+          static_cast<unsigned long long>(n_aborts(s)));
+  fprintf(stderr,
+          "too new: %llu changed: %llu locked: %llu invalidated: %llu\n",
+          static_cast<unsigned long long>(n_aborts(s, abort_reason::too_new)),
+          static_cast<unsigned long long>(n_aborts(s, abort_reason::changed)),
+          static_cast<unsigned long long>(n_aborts(s, abort_reason::locked)),
+          static_cast<unsigned long long>(
+              n_aborts(s, abort_reason::invalidated)));
+  fprintf(stderr,
+          "parks: %llu wakeups: %llu log bytes: %llu accesses: %llu\n",
+          static_cast<unsigned long long>(s.n_parks),
+          static_cast<unsigned long long>(s.n_wakeups),
+          static_cast<unsigned long long>(s.n_log_bytes),
+          static_cast<unsigned long long>(s.n_accesses));
+
+  if (!TRADE_V1_STATS) {
+    verify(0 == s.n_starts);
+    verify(0 == s.n_commits);
+    verify(0 == n_aborts(s));
+    return;
+  }
+
+  verify(s.n_starts == s.n_commits + n_aborts(s));
+
+  verify(1 == n_aborts(s, abort_reason::readonly_escalation));
+  verify(TRADE_V1_EXCEPTIONS == n_aborts(s, abort_reason::user_exception));
+  verify(s.n_parks <= n_aborts(s, abort_reason::retry));
+  verify(s.n_spurious_wakeups <= s.n_wakeups);
+
+  uint64_t n_attempts = 0;
+  for (auto n_bucket : s.n_attempts_by_size)
+    n_attempts += n_bucket;
+  verify(n_attempts == s.n_starts);
+  verify(s.n_accesses <= s.n_log_bytes);
+
+  reset_stats();
+
+  s = get_stats();
+  verify(0 == s.n_starts);
+  verify(0 == s.n_commits);
+  verify(0 == n_aborts(s));
+
+  atomically([&]() { x = x + y; });
+
+  s = get_stats();
+  verify(1 == s.n_starts);
+  verify(1 == s.n_commits);
+  verify(2 == s.n_accesses);
+  verify(1 == s.n_attempts_by_size[2]);
+  verify(1 == s.n_lock_acquisitions);
+
+#if TRADE_V1_EXCEPTIONS
+  {
+    // A wakeup followed by an exception does not make the next retry
+    // spurious.
+    atom<bool> thrown = false, ready = false;
+
+    reset_stats();
+
+    std::thread waiter([&]() {
+      try {
+        atomically([&]() {
+          if (!thrown)
+            retry();
+          throw 1;
+        });
+      } catch (int) {
+      }
+      atomically([&]() {
+        if (!ready)
+          retry();
+      });
+    });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    atomically([&]() { thrown = true; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    atomically([&]() { ready = true; });
+
+    waiter.join();
+
+    s = get_stats();
+    verify(0 == s.n_spurious_wakeups);
+  }
+#endif
+});
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "trade_v1/trade.hpp"
+
+#include "polyfill_v1/memory.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace trade_v1 {
+
+/// A transactional bounded FIFO queue implemented as a ring of slots.
+/// Operations called outside of a transaction run as transactions of their own
+/// and operations called inside `atomically` compose with the rest of the
+/// transaction.
+///
+/// Producers access only the count of pushed elements and the slots they fill
+/// and consumers only the count of popped elements and the slots they empty, so
+/// producers and consumers do not conflict unless the queue is nearly empty or
+/// nearly full.  Elements are stored in the slots and no memory is allocated
+/// per element.  `Value` must be a valid type for `atom`.
+template <class Value> class bounded_queue_tm {
+  struct slot_t {
+    lock_group m_group;
+    atom<bool, lock_group> m_full{m_group, false};
+    atom<Value, lock_group> m_value{m_group};
+  };
+
+  struct alignas(64) count_t {
+    atom<size_t> m_value{0};
+  };
+
+  size_t m_capacity;
+  std::unique_ptr<slot_t[]> m_slots;
+  count_t m_pushed;
+  count_t m_popped;
+
+  slot_t &slot(size_t ticket) const;
+
+  // Initial log size of bulk operations, which access two atoms per element.
+  static size_t log_size(size_t n);
+
+public:
+  using value_type = Value;
+
+  /// Constructs an empty queue with room for `capacity` elements.  `capacity`
+  /// must be positive.
+  explicit bounded_queue_tm(size_t capacity);
+
+  bounded_queue_tm(const bounded_queue_tm &) = delete;
+  bounded_queue_tm &operator=(const bounded_queue_tm &) = delete;
+
+  /// Returns the maximum number of elements.
+  size_t capacity() const;
+
+  /// Returns the number of elements.  Reads both the count of pushed and the
+  /// count of popped elements, so a transaction calling `size` conflicts with
+  /// concurrent pushes and pops.
+  size_t size() const;
+
+  /// Returns whether the queue has no elements.  Only accesses the consumer
+  /// side of the queue.
+  bool empty() const;
+
+  /// Pushes the value to the back of the queue unless the queue is full.
+  /// Returns whether the value was pushed.
+  bool try_push_back(const Value &value);
+
+  /// Pushes the value to the back of the queue.  Blocks with `retry` while the
+  /// queue is full.
+  void push_back(const Value &value);
+
+  /// Pushes the `n` values to the back of the queue in order.  Blocks with
+  /// `retry` until there is room for all of the values.  `n` must not exceed
+  /// the capacity, as the queue would otherwise never have room.
+  void push_back_n(const Value *values, size_t n);
+
+  /// Pops the value at the front of the queue or returns `std::nullopt` if the
+  /// queue is empty.
+  std::optional<Value> try_pop_front();
+
+  /// Pops the value at the front of the queue.  Blocks with `retry` while the
+  /// queue is empty.
+  Value pop_front();
+
+  /// Pops up to `n` values from the front of the queue to `values` in order and
+  /// returns the number of values popped.  Blocks with `retry` while the queue
+  /// is empty.
+  size_t pop_front_n(Value *values, size_t n);
+};
+
+template <class Value>
+typename bounded_queue_tm<Value>::slot_t &
+bounded_queue_tm<Value>::slot(size_t ticket) const {
+  return m_slots[ticket % m_capacity];
+}
+
+template <class Value> size_t bounded_queue_tm<Value>::log_size(size_t n) {
+  return 256 + n * 2 * (64 + sizeof(Value));
+}
+
+template <class Value>
+bounded_queue_tm<Value>::bounded_queue_tm(size_t capacity)
+    : m_capacity(capacity), m_slots(new slot_t[capacity]) {
+  assert(0 < capacity);
+}
+
+template <class Value> size_t bounded_queue_tm<Value>::capacity() const {
+  return m_capacity;
+}
+
+template <class Value> size_t bounded_queue_tm<Value>::size() const {
+  return atomically(assume_readonly, [&]() {
+    return m_pushed.m_value.load() - m_popped.m_value.load();
+  });
+}
+
+template <class Value> bool bounded_queue_tm<Value>::empty() const {
+  return atomically(assume_readonly,
+                    [&]() { return !slot(m_popped.m_value).m_full.load(); });
+}
+
+template <class Value>
+bool bounded_queue_tm<Value>::try_push_back(const Value &value) {
+  return atomically([&]() {
+    size_t ticket = m_pushed.m_value;
+    auto &slot = this->slot(ticket);
+    if (slot.m_full)
+      return false;
+    // The value is copied, because the transaction may be restarted.
+    slot.m_value = value;
+    slot.m_full = true;
+    m_pushed.m_value = ticket + 1;
+    return true;
+  });
+}
+
+template <class Value>
+void bounded_queue_tm<Value>::push_back(const Value &value) {
+  atomically([&]() {
+    if (!try_push_back(value))
+      retry();
+  });
+}
+
+template <class Value>
+void bounded_queue_tm<Value>::push_back_n(const Value *values, size_t n) {
+  assert(n <= m_capacity);
+  if (!n)
+    return;
+  atomically(heap(log_size(n)), [&]() {
+    size_t ticket = m_pushed.m_value;
+    // Slots are emptied in order, so all of the slots are empty if the last
+    // one is.
+    if (slot(ticket + n - 1).m_full)
+      retry();
+    for (size_t i = 0; i < n; ++i) {
+      auto &slot = this->slot(ticket + i);
+      slot.m_value = values[i];
+      slot.m_full = true;
+    }
+    m_pushed.m_value = ticket + n;
+  });
+}
+
+template <class Value>
+std::optional<Value> bounded_queue_tm<Value>::try_pop_front() {
+  return atomically([&]() -> std::optional<Value> {
+    size_t ticket = m_popped.m_value;
+    auto &slot = this->slot(ticket);
+    if (!slot.m_full)
+      return std::nullopt;
+    Value value = std::move(slot.m_value.ref());
+    slot.m_value = Value();
+    slot.m_full = false;
+    m_popped.m_value = ticket + 1;
+    return value;
+  });
+}
+
+template <class Value> Value bounded_queue_tm<Value>::pop_front() {
+  return atomically([&]() {
+    if (auto value = try_pop_front())
+      return std::move(*value);
+    retry();
+  });
+}
+
+template <class Value>
+size_t bounded_queue_tm<Value>::pop_front_n(Value *values, size_t n) {
+  if (!n)
+    return 0;
+  return atomically(heap(log_size(n)), [&]() {
+    size_t ticket = m_popped.m_value;
+    size_t i = 0;
+    // Slots are filled in order, so the full slots are consecutive.
+    for (; i < n; ++i) {
+      auto &slot = this->slot(ticket + i);
+      if (!slot.m_full)
+        break;
+      values[i] = std::move(slot.m_value.ref());
+      slot.m_value = Value();
+      slot.m_full = false;
+    }
+    if (!i)
+      retry();
+    m_popped.m_value = ticket + i;
+    return i;
+  });
+}
+
+} // namespace trade_v1
@@ -0,0 +1,140 @@
+#pragma once
+
+#include "trade_v1/trade.hpp"
+
+#include <cstddef>
+#include <type_traits>
+
+namespace trade_v1 {
+
+/// A transactional counter.  Operations called outside of a transaction run as
+/// transactions of their own and operations called inside `atomically` compose
+/// with the rest of the transaction.
+///
+/// The counter is split into `Shards` atoms on separate cache lines and each
+/// thread adds to its own shard.  An `add` does not read the shard, but is
+/// logged as a delta that is added to the shard on commit, so concurrent adds
+/// do not conflict even when threads share a shard.  Reading the counter reads
+/// every shard and conflicts with concurrent adds.
+///
+/// `take` implements escrow: it subtracts from the counter only if the counter
+/// has enough and otherwise blocks with `retry` until enough has been added.
+/// Takes usually only access the shard of the thread and do not conflict with
+/// adds to other shards.
+template <class Value, size_t Shards = 8> class counter {
+  static_assert(std::is_arithmetic_v<Value>);
+  static_assert(0 < Shards);
+
+  struct alignas(64) shard_t {
+    atom<Value> m_value{0};
+  };
+
+  shard_t m_shards[Shards];
+
+  atom<Value> &own_shard();
+
+public:
+  using value_type = Value;
+
+  /// Constructs a counter with the given initial value.
+  explicit counter(Value initial = 0);
+
+  counter(const counter &) = delete;
+  counter &operator=(const counter &) = delete;
+
+  /// Adds the delta to the counter without reading the counter.  Loading the
+  /// counter later in the same transaction sees the delta.
+  void add(Value delta);
+
+  /// Returns the value of the counter.  Reads every shard.
+  Value load() const;
+
+  /// Returns the value of the counter outside of transactions.  Only safe when
+  /// the counter is not being modified concurrently.
+  Value unsafe_load() const;
+
+  /// Subtracts the non-negative amount from the counter unless that would make
+  /// the counter less than zero.  Returns whether the amount was subtracted.
+  bool try_take(Value amount);
+
+  /// Subtracts the non-negative amount from the counter.  Blocks with `retry`
+  /// while that would make the counter less than zero.
+  void take(Value amount);
+};
+
+template <class Value, size_t Shards>
+atom<Value> &counter<Value, Shards>::own_shard() {
+  return m_shards[Private::thread_index() % Shards].m_value;
+}
+
+template <class Value, size_t Shards>
+counter<Value, Shards>::counter(Value initial) {
+  if (initial)
+    atomically([&]() { m_shards[0].m_value = initial; });
+}
+
+template <class Value, size_t Shards>
+void counter<Value, Shards>::add(Value delta) {
+  atomically([&]() { Private::add<Value>(own_shard(), delta); });
+}
+
+template <class Value, size_t Shards>
+Value counter<Value, Shards>::load() const {
+  return atomically(assume_readonly, [&]() {
+    Value sum = 0;
+    for (auto &shard : m_shards)
+      sum += Private::load_sum<Value>(shard.m_value);
+    return sum;
+  });
+}
+
+template <class Value, size_t Shards>
+Value counter<Value, Shards>::unsafe_load() const {
+  Value sum = 0;
+  for (auto &shard : m_shards)
+    sum += shard.m_value.unsafe_load();
+  return sum;
+}
+
+template <class Value, size_t Shards>
+bool counter<Value, Shards>::try_take(Value amount) {
+  return atomically([&]() {
+    auto &own = own_shard();
+    Value available = Private::load_sum<Value>(own);
+    if (amount <= available) {
+      own = available - amount;
+      return true;
+    }
+
+    for (auto &shard : m_shards)
+      if (&shard.m_value != &own)
+        available += Private::load_sum<Value>(shard.m_value);
+    if (available < amount)
+      return false;
+
+    // Drains the own shard first and then other shards in order.
+    Value needed = amount - Private::load_sum<Value>(own);
+    own = 0;
+    for (auto &shard : m_shards) {
+      if (!needed)
+        break;
+      if (&shard.m_value == &own)
+        continue;
+      Value value = Private::load_sum<Value>(shard.m_value);
+      Value part = value < needed ? value : needed;
+      shard.m_value = value - part;
+      needed -= part;
+    }
+    return true;
+  });
+}
+
+template <class Value, size_t Shards>
+void counter<Value, Shards>::take(Value amount) {
+  atomically([&]() {
+    if (!try_take(amount))
+      retry();
+  });
+}
+
+} // namespace trade_v1
@@ -0,0 +1,355 @@
+#pragma once
+
+#include "trade_v1/trade.hpp"
+
+#include "polyfill_v1/memory.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <optional>
+
+namespace trade_v1 {
+
+/// A transactional hash map.  Operations called outside of a transaction run
+/// as transactions of their own and operations called inside `atomically`
+/// compose with the rest of the transaction.
+///
+/// Each bucket is an atom holding an immutable chain of nodes, so operations on
+/// keys in different buckets do not conflict.  The number of elements is kept
+/// in striped counters, so inserts and erases of keys in different buckets
+/// also rarely conflict on the count.  The table grows by moving one bucket per
+/// transaction, so growing only conflicts with transactions accessing the
+/// bucket being moved.  Growing is triggered by `insert`, after the outermost
+/// transaction has committed, or explicitly by `reserve`.  The table never
+/// shrinks.
+template <class Key,
+          class Value,
+          class Hash = std::hash<Key>,
+          class Equal = std::equal_to<Key>>
+class hash_map_tm {
+  struct link_t {};
+
+  using chain_t = std::shared_ptr<const link_t>;
+
+  struct node_t : link_t {
+    chain_t m_next;
+    size_t m_hash;
+    Key m_key;
+    Value m_value;
+
+    template <class ForwardableValue>
+    node_t(chain_t next,
+           size_t hash,
+           const Key &key,
+           ForwardableValue &&value)
+        : m_next(std::move(next)),
+          m_hash(hash),
+          m_key(key),
+          m_value(std::forward<ForwardableValue>(value)) {}
+  };
+
+  // A bucket that has been moved to the next table holds this marker.
+  static inline const link_t s_moved{};
+
+  struct table_t {
+    size_t m_mask;
+    std::unique_ptr<atom<chain_t>[]> m_buckets;
+
+    // Set before the first bucket is moved.
+    std::atomic<table_t *> m_next;
+
+    // Previous tables are kept alive, because transactions may still be
+    // following moved buckets through them and there is no way to tell when
+    // no transaction is.  Each table has half the buckets of the next, so the
+    // previous tables take less memory than the current one.
+    std::unique_ptr<table_t> m_previous;
+
+    explicit table_t(size_t n_buckets)
+        : m_mask(n_buckets - 1),
+          m_buckets(new atom<chain_t>[n_buckets]),
+          m_next(nullptr) {}
+  };
+
+  static constexpr size_t n_stripes = 64, max_load = 2;
+
+  struct alignas(64) stripe_t {
+    atom<ptrdiff_t> m_count{0};
+  };
+
+  std::atomic<table_t *> m_table;
+  stripe_t m_stripes[n_stripes];
+  std::mutex m_grow_mutex;
+  Hash m_hasher;
+  Equal m_equal;
+
+  atom<chain_t> &bucket(size_t hash, chain_t &chain) const;
+
+  const node_t *find_node(const link_t *link,
+                          size_t hash,
+                          const Key &key) const;
+
+  // Returns a copy of the chain starting at `link` with the chain starting at
+  // `target` replaced by `tail`.
+  static chain_t
+  replace(const link_t *link, const link_t *target, chain_t tail);
+
+  // Grows the table unless it is already being grown or the number of elements
+  // is within the maximum load.
+  void maybe_grow();
+
+  // Grows the table to at least the given number of buckets.  Must be called
+  // with `m_grow_mutex` held.
+  void grow_to(size_t n_buckets);
+
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+
+  /// Constructs an empty map with at least the given number of buckets.
+  explicit hash_map_tm(size_t n_buckets = 16);
+
+  ~hash_map_tm();
+
+  hash_map_tm(const hash_map_tm &) = delete;
+  hash_map_tm &operator=(const hash_map_tm &) = delete;
+
+  /// Returns the number of elements.  Reads every counter stripe, so a
+  /// transaction calling `size` conflicts with concurrent inserts and erases.
+  size_t size() const;
+
+  /// Returns whether the map has no elements.  Like `size`.
+  bool empty() const;
+
+  /// Returns the value of the key or `std::nullopt` if the key is not present.
+  std::optional<Value> find(const Key &key) const;
+
+  /// Inserts the key with the given value unless the key is already present.
+  /// Returns whether the key was inserted.
+  template <class ForwardableValue>
+  bool insert(const Key &key, ForwardableValue &&value);
+
+  /// Replaces the value of the key with `fn(value)` if the key is present.
+  /// Returns whether the key was present.
+  template <class Function> bool update(const Key &key, Function &&fn);
+
+  /// Erases the key.  Returns whether the key was present.
+  bool erase(const Key &key);
+
+  /// Grows the table to hold the given number of elements without further
+  /// growing.  Must be called outside of transactions.
+  void reserve(size_t n_elements);
+
+  /// Returns the number of buckets of the table.
+  size_t bucket_count() const;
+};
+
+template <class Key, class Value, class Hash, class Equal>
+atom<typename hash_map_tm<Key, Value, Hash, Equal>::chain_t> &
+hash_map_tm<Key, Value, Hash, Equal>::bucket(size_t hash,
+                                             chain_t &chain) const {
+  auto table = m_table.load(std::memory_order_acquire);
+  while (true) {
+    auto &bucket = table->m_buckets[hash & table->m_mask];
+    chain = bucket.load();
+    if (chain.get() != &s_moved)
+      return bucket;
+    table = table->m_next.load(std::memory_order_acquire);
+  }
+}
+
+template <class Key, class Value, class Hash, class Equal>
+const typename hash_map_tm<Key, Value, Hash, Equal>::node_t *
+hash_map_tm<Key, Value, Hash, Equal>::find_node(const link_t *link,
+                                                size_t hash,
+                                                const Key &key) const {
+  while (link) {
+    auto node = static_cast<const node_t *>(link);
+    if (node->m_hash == hash && m_equal(node->m_key, key))
+      return node;
+    link = node->m_next.get();
+  }
+  return nullptr;
+}
+
+template <class Key, class Value, class Hash, class Equal>
+typename hash_map_tm<Key, Value, Hash, Equal>::chain_t
+hash_map_tm<Key, Value, Hash, Equal>::replace(const link_t *link,
+                                              const link_t *target,
+                                              chain_t tail) {
+  if (link == target)
+    return tail;
+  auto node = static_cast<const node_t *>(link);
+  return std::make_shared<node_t>(
+      replace(node->m_next.get(), target, std::move(tail)),
+      node->m_hash,
+      node->m_key,
+      node->m_value);
+}
+
+template <class Key, class Value, class Hash, class Equal>
+void hash_map_tm<Key, Value, Hash, Equal>::maybe_grow() {
+  std::unique_lock<std::mutex> guard(m_grow_mutex, std::try_to_lock);
+  if (!guard)
+    return;
+  auto n_buckets = m_table.load(std::memory_order_relaxed)->m_mask + 1;
+  auto n_elements = size();
+  auto n = n_buckets;
+  while (max_load * n < n_elements)
+    n *= 2;
+  if (n_buckets < n)
+    grow_to(n);
+}
+
+template <class Key, class Value, class Hash, class Equal>
+void hash_map_tm<Key, Value, Hash, Equal>::grow_to(size_t n_buckets) {
+  auto table = m_table.load(std::memory_order_relaxed);
+  while (table->m_mask + 1 < n_buckets) {
+    auto n = table->m_mask + 1;
+    auto next = table->m_next.load(std::memory_order_relaxed);
+    if (!next) {
+      next = new table_t(2 * n);
+      table->m_next.store(next, std::memory_order_release);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      atomically([&]() {
+        chain_t chain = table->m_buckets[i];
+        if (chain.get() == &s_moved)
+          return;
+        chain_t low, high;
+        for (auto link = chain.get(); link;) {
+          auto node = static_cast<const node_t *>(link);
+          auto &half = node->m_hash & n ? high : low;
+          half = std::make_shared<node_t>(
+              std::move(half), node->m_hash, node->m_key, node->m_value);
+          link = node->m_next.get();
+        }
+        next->m_buckets[i] = std::move(low);
+        next->m_buckets[i + n] = std::move(high);
+        table->m_buckets[i] = chain_t(chain_t(), &s_moved);
+      });
+    }
+    next->m_previous.reset(table);
+    m_table.store(next, std::memory_order_release);
+    table = next;
+  }
+}
+
+template <class Key, class Value, class Hash, class Equal>
+hash_map_tm<Key, Value, Hash, Equal>::hash_map_tm(size_t n_buckets) {
+  size_t n = 1;
+  while (n < n_buckets)
+    n *= 2;
+  m_table.store(new table_t(n), std::memory_order_relaxed);
+}
+
+template <class Key, class Value, class Hash, class Equal>
+hash_map_tm<Key, Value, Hash, Equal>::~hash_map_tm() {
+  auto table = m_table.load(std::memory_order_relaxed);
+  delete table->m_next.load(std::memory_order_relaxed);
+  delete table;
+}
+
+template <class Key, class Value, class Hash, class Equal>
+size_t hash_map_tm<Key, Value, Hash, Equal>::size() const {
+  return atomically(assume_readonly, [&]() {
+    ptrdiff_t n = 0;
+    for (auto &stripe : m_stripes)
+      n += stripe.m_count;
+    return static_cast<size_t>(n);
+  });
+}
+
+template <class Key, class Value, class Hash, class Equal>
+bool hash_map_tm<Key, Value, Hash, Equal>::empty() const {
+  return 0 == size();
+}
+
+template <class Key, class Value, class Hash, class Equal>
+std::optional<Value>
+hash_map_tm<Key, Value, Hash, Equal>::find(const Key &key) const {
+  auto hash = m_hasher(key);
+  return atomically(assume_readonly, [&]() -> std::optional<Value> {
+    chain_t chain;
+    bucket(hash, chain);
+    if (auto node = find_node(chain.get(), hash, key))
+      return node->m_value;
+    return std::nullopt;
+  });
+}
+
+template <class Key, class Value, class Hash, class Equal>
+template <class ForwardableValue>
+bool hash_map_tm<Key, Value, Hash, Equal>::insert(const Key &key,
+                                                  ForwardableValue &&value) {
+  auto hash = m_hasher(key);
+  auto node = std::make_shared<node_t>(
+      nullptr, hash, key, std::forward<ForwardableValue>(value));
+  auto count = atomically([&]() -> ptrdiff_t {
+    chain_t chain;
+    auto &bucket = this->bucket(hash, chain);
+    if (find_node(chain.get(), hash, key))
+      return 0;
+    node->m_next = std::move(chain);
+    bucket = node;
+    return m_stripes[hash % n_stripes].m_count.ref() += 1;
+  });
+  if (!count)
+    return false;
+  // A stripe is an estimate of the size divided by the number of stripes.
+  // Growing moves buckets in transactions of its own, so it waits for the
+  // outermost transaction to commit.
+  if (max_load * bucket_count() < static_cast<size_t>(count) * n_stripes)
+    after_commit(
+        [](void *map) { static_cast<hash_map_tm *>(map)->maybe_grow(); },
+        this);
+  return true;
+}
+
+template <class Key, class Value, class Hash, class Equal>
+template <class Function>
+bool hash_map_tm<Key, Value, Hash, Equal>::update(const Key &key,
+                                                  Function &&fn) {
+  auto hash = m_hasher(key);
+  return atomically([&]() {
+    chain_t chain;
+    auto &bucket = this->bucket(hash, chain);
+    auto node = find_node(chain.get(), hash, key);
+    if (!node)
+      return false;
+    bucket = replace(chain.get(),
+                     node,
+                     std::make_shared<node_t>(
+                         node->m_next, hash, node->m_key, fn(node->m_value)));
+    return true;
+  });
+}
+
+template <class Key, class Value, class Hash, class Equal>
+bool hash_map_tm<Key, Value, Hash, Equal>::erase(const Key &key) {
+  auto hash = m_hasher(key);
+  return atomically([&]() {
+    chain_t chain;
+    auto &bucket = this->bucket(hash, chain);
+    auto node = find_node(chain.get(), hash, key);
+    if (!node)
+      return false;
+    bucket = replace(chain.get(), node, node->m_next);
+    m_stripes[hash % n_stripes].m_count.ref() -= 1;
+    return true;
+  });
+}
+
+template <class Key, class Value, class Hash, class Equal>
+void hash_map_tm<Key, Value, Hash, Equal>::reserve(size_t n_elements) {
+  std::unique_lock<std::mutex> guard(m_grow_mutex);
+  grow_to((n_elements + max_load - 1) / max_load);
+}
+
+template <class Key, class Value, class Hash, class Equal>
+size_t hash_map_tm<Key, Value, Hash, Equal>::bucket_count() const {
+  return m_table.load(std::memory_order_acquire)->m_mask + 1;
+}
+
+} // namespace trade_v1
@@ -12,6 +12,19 @@ void trade_v1::Private::access_t<Value, false>::retain_move() {
   new (&m_original) Value(std::move(m_current));
 }
 
+template <class Value>
+void trade_v1::Private::access_t<Value, false>::undo(state_t state,
+                                                    Value &saved) {
+  if (INITIAL == state) {
+    m_current.~Value();
+  } else {
+    m_current = std::move(saved);
+    if (READ + WRITTEN == m_state && READ == state)
+      m_original.~Value();
+  }
+  m_state = state;
+}
+
 template <class Value>
 void trade_v1::Private::access_t<Value, false>::destroy() {
   if (INITIAL != m_state) {
@@ -27,5 +40,13 @@ void trade_v1::Private::access_t<Value, true>::retain_copy() {}
 template <class Value>
 void trade_v1::Private::access_t<Value, true>::retain_move() {}
 
+template <class Value>
+void trade_v1::Private::access_t<Value, true>::undo(state_t state,
+                                                   Value &saved) {
+  if (INITIAL != state)
+    m_current = saved;
+  m_state = state;
+}
+
 template <class Value>
 void trade_v1::Private::access_t<Value, true>::destroy() {}
@@ -6,7 +6,8 @@ struct trade_v1::Private::access_base_t {
   access_base_t *m_children[2];
   atom_mono_t *m_atom;
   state_t m_state;
-  lock_ix_t m_lock_ix;
+  uint32_t m_saved_in;
+  lock_t *m_lock;
   destroy_t m_destroy;
 };
 
@@ -19,6 +20,7 @@ struct trade_v1::Private::access_t<Value, false> : access_base_t {
 
   void retain_copy();
   void retain_move();
+  void undo(state_t state, Value &saved);
   void destroy();
 };
 
@@ -30,5 +32,36 @@ struct trade_v1::Private::access_t<Value, true> : access_base_t {
 
   void retain_copy();
   void retain_move();
+  void undo(state_t state, Value &saved);
   void destroy();
 };
+
+// A member written through an access in state `FIELDS`.  The value of the
+// member follows the record.
+struct alignas(std::max_align_t) trade_v1::Private::field_t {
+  field_t *m_next;
+  uint32_t m_offset;
+  uint32_t m_size;
+};
+
+template <class Value>
+struct trade_v1::Private::access_fields_t : access_t<Value> {
+  ~access_fields_t() = delete;
+
+  field_t *m_fields;
+};
+
+struct trade_v1::Private::undo_base_t {
+  undo_base_t *m_next;
+  access_base_t *m_access;
+  state_t m_state;
+  uint32_t m_saved_in;
+  undo_fn_t m_undo;
+};
+
+template <class Value> struct trade_v1::Private::undo_t : undo_base_t {
+  ~undo_t() = delete;
+
+  // Only constructed when `m_state` is not `INITIAL`.
+  Value m_saved;
+};
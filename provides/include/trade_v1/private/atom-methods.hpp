@@ -2,7 +2,55 @@
 
 #include "trade_v1/private/atom.hpp"
 
-template <class Value> trade_v1::Private::atom_t<Value>::atom_t() {}
+#include "trade_v1/synopsis.hpp"
 
-template <class Value>
-trade_v1::Private::atom_t<Value>::atom_t(const Value &value) : m_value(value) {}
+inline trade_v1::Private::lock_t &
+trade_v1::Private::atom_lock_t<trade_v1::hashed_lock>::lock() const {
+  return s_locks[lock_ix_of(this)];
+}
+
+inline trade_v1::Private::atom_lock_t<trade_v1::inline_lock>::atom_lock_t()
+    : m_lock{{0}, nullptr} {}
+
+inline trade_v1::Private::lock_t &
+trade_v1::Private::atom_lock_t<trade_v1::inline_lock>::lock() const {
+  return m_lock;
+}
+
+inline trade_v1::Private::atom_lock_t<trade_v1::lock_group>::atom_lock_t(
+    lock_group &group)
+    : m_lock(&group) {}
+
+inline trade_v1::Private::lock_t &
+trade_v1::Private::atom_lock_t<trade_v1::lock_group>::lock() const {
+  return *m_lock;
+}
+
+template <class Value, class Lock, size_t Depth>
+void trade_v1::Private::atom_history_t<Value,
+                                       trade_v1::versioned<Lock, Depth>>::
+    retain(clock_t from, clock_t until, const Value &value) {
+  auto &version = m_versions[m_next];
+  m_next = (m_next + 1) % Depth;
+  version.m_until.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  version.m_from.store(from, std::memory_order_relaxed);
+  version.m_value.store(value, std::memory_order_relaxed);
+  version.m_until.store(until, std::memory_order_release);
+}
+
+template <class Value, class Lock>
+trade_v1::Private::atom_t<Value, Lock>::atom_t() {}
+
+template <class Value, class Lock>
+trade_v1::Private::atom_t<Value, Lock>::atom_t(const Value &value)
+    : m_value(value) {}
+
+template <class Value, class Lock>
+trade_v1::Private::atom_t<Value, Lock>::atom_t(lock_group &group)
+    : atom_lock_t<Lock>(group) {}
+
+template <class Value, class Lock>
+trade_v1::Private::atom_t<Value, Lock>::atom_t(lock_group &group,
+                                               const Value &value)
+    : atom_lock_t<Lock>(group), m_value(value) {}
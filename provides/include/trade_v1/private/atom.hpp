@@ -1,21 +1,90 @@
 #pragma once
 
+#include "trade_v1/private/lock.hpp"
 #include "trade_v1/private/non_atomic.hpp"
 
 class trade_v1::Private::atom_mono_t {
   friend class Private;
 };
 
-template <class Value> class trade_v1::Private::atom_t : Private::atom_mono_t {
+template <>
+class trade_v1::Private::atom_lock_t<trade_v1::hashed_lock> : atom_mono_t {
   friend class Private;
-  template <class> friend struct trade_v1::atom;
 
-  static constexpr bool is_atomic = !std::is_trivially_copyable_v<Value> ||
-                                    std::atomic<Value>::is_always_lock_free;
+  lock_t &lock() const;
+};
+
+template <>
+class trade_v1::Private::atom_lock_t<trade_v1::inline_lock> : atom_mono_t {
+  friend class Private;
+
+  atom_lock_t();
+
+  lock_t &lock() const;
+
+  mutable lock_t m_lock;
+};
+
+template <>
+class trade_v1::Private::atom_lock_t<trade_v1::lock_group> : atom_mono_t {
+  friend class Private;
+
+  atom_lock_t(lock_group &group);
+
+  lock_t &lock() const;
+
+  lock_t *m_lock;
+};
+
+template <class Lock, size_t Depth>
+class trade_v1::Private::atom_lock_t<trade_v1::versioned<Lock, Depth>>
+    : public atom_lock_t<Lock> {
+  friend class Private;
+
+  using atom_lock_t<Lock>::atom_lock_t;
+};
+
+template <class Value, class Lock> class trade_v1::Private::atom_history_t {
+  friend class Private;
+
+  static constexpr bool is_versioned = false;
+};
+
+template <class Value, class Lock, size_t Depth>
+class trade_v1::Private::atom_history_t<Value,
+                                        trade_v1::versioned<Lock, Depth>> {
+  friend class Private;
+
+  static constexpr bool is_versioned = true;
+
+  // A previous value that was current from version `m_from` until version
+  // `m_until`.  A slot being overwritten has `m_until` of `0`.
+  struct version_t {
+    std::atomic<clock_t> m_from{0};
+    std::atomic<clock_t> m_until{0};
+    cell_t<Value> m_value;
+  };
+
+  // Previous values in a ring overwritten oldest first.  Only written by
+  // commits holding the lock of the atom.
+  version_t m_versions[Depth];
+  size_t m_next = 0;
+
+  void retain(clock_t from, clock_t until, const Value &value);
+};
+
+template <class Value, class Lock>
+class trade_v1::Private::atom_t : Private::atom_lock_t<Lock>,
+                                  Private::atom_history_t<Value, Lock> {
+  friend class Private;
+  template <class, class> friend struct trade_v1::atom;
+
+  static constexpr bool is_atomic = is_atomic_v<Value>;
 
-  std::conditional_t<is_atomic, std::atomic<Value>, non_atomic_t<Value>>
-      m_value;
+  cell_t<Value> m_value;
 
   atom_t();
   atom_t(const Value &value);
+  atom_t(lock_group &group);
+  atom_t(lock_group &group, const Value &value);
 };
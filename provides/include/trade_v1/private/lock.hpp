@@ -2,7 +2,7 @@
 
 #include "trade_v1/private/private.hpp"
 
-struct trade_v1::Private::lock_t {
+struct alignas(TRADE_V1_LOCK_ALIGN) trade_v1::Private::lock_t {
   std::atomic<clock_t> m_clock;
-  waiter_t *m_first;
+  std::atomic<waiter_t *> m_first;
 };
@@ -2,6 +2,8 @@
 
 #include "trade_v1/private/private.hpp"
 
+#include <cstring>
+
 template <class Value> trade_v1::Private::non_atomic_t<Value>::non_atomic_t() {}
 
 template <class Value>
@@ -19,3 +21,19 @@ const Value &
 trade_v1::Private::non_atomic_t<Value>::load(std::memory_order) const {
   return m_value;
 }
+
+template <class Value>
+template <class Field>
+size_t
+trade_v1::Private::non_atomic_t<Value>::offset_of(Field Value::*member) const {
+  return static_cast<size_t>(
+      reinterpret_cast<const uint8_t *>(&(m_value.*member)) -
+      reinterpret_cast<const uint8_t *>(&m_value));
+}
+
+template <class Value>
+void trade_v1::Private::non_atomic_t<Value>::store(size_t offset,
+                                                   const void *bytes,
+                                                   size_t size) {
+  std::memcpy(reinterpret_cast<uint8_t *>(&m_value) + offset, bytes, size);
+}
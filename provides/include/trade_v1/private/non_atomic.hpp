@@ -11,5 +11,8 @@ template <class Value> class trade_v1::Private::non_atomic_t {
   void store(const Value &value, std::memory_order = std::memory_order_relaxed);
   const Value &load(std::memory_order = std::memory_order_relaxed) const;
 
+  template <class Field> size_t offset_of(Field Value::*member) const;
+  void store(size_t offset, const void *bytes, size_t size);
+
   Value m_value;
 };
@@ -3,80 +3,192 @@
 #include "trade_v1/config.hpp"
 #include "trade_v1/private/access-methods.hpp"
 #include "trade_v1/private/lock.hpp"
+#include "trade_v1/private/run.hpp"
 #include "trade_v1/private/transaction-methods.hpp"
 
 #include "molecular_v1/backoff.hpp"
 
+#include <cstring>
 #include <utility>
 
 inline trade_v1::Private::lock_ix_t
 trade_v1::Private::lock_ix_of(const atom_mono_t *atom) {
-  return static_cast<lock_ix_t>(reinterpret_cast<size_t>(atom) % n_locks);
+  auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(atom));
+  if constexpr (lock_hash == lock_hash_t::fibonacci) {
+    constexpr int shift = [] {
+      int bits = 64;
+      for (auto n = n_locks; 1 < n; n >>= 1)
+        bits -= 1;
+      return bits;
+    }();
+    return static_cast<lock_ix_t>(
+        (address * UINT64_C(0x9E3779B97F4A7C15)) >> shift);
+  } else {
+    return static_cast<lock_ix_t>(address % n_locks);
+  }
 }
 
 template <class Value>
+trade_v1::Private::lock_ix_t
+trade_v1::Private::lock_ix_of(const atom_t<Value, hashed_lock> &atom) {
+  return lock_ix_of(static_cast<const atom_mono_t *>(&atom));
+}
+
+template <class Value, class Lock>
 void trade_v1::Private::destroy(clock_t t, access_base_t *access_base) {
   auto access = static_cast<access_t<Value> *>(access_base);
   if (t) {
-    auto atom = static_cast<atom_t<Value> *>(access->m_atom);
-    atom->m_value.store(access->m_current, std::memory_order_relaxed);
-    auto ix = access->m_lock_ix;
-    if (0 <= ix) {
-      auto &lock = s_locks[ix];
-      if (auto first = lock.m_first)
-        signal(first);
-      lock.m_clock.store(t, std::memory_order_release);
+    auto atom = static_cast<atom_t<Value, Lock> *>(access->m_atom);
+    if constexpr (std::is_arithmetic_v<Value>)
+      if (access->m_state & DELTA)
+        access->m_current += atom->m_value.load(std::memory_order_relaxed);
+    if constexpr (atom_t<Value, Lock>::is_versioned) {
+      // The lock is still held, so it has the inverted previous version.
+      auto &lock = atom->lock();
+      atom->retain(~lock.m_clock.load(std::memory_order_relaxed) & ~waiting_bit,
+                   t,
+                   atom->m_value.load(std::memory_order_relaxed));
+    }
+    if constexpr (atom_t<Value, Lock>::is_atomic) {
+      atom->m_value.store(access->m_current, std::memory_order_relaxed);
+    } else if (access->m_state & FIELDS) {
+      for (auto field = static_cast<access_fields_t<Value> *>(access)->m_fields;
+           field;
+           field = field->m_next)
+        atom->m_value.store(field->m_offset, field + 1, field->m_size);
+    } else {
+      atom->m_value.store(access->m_current);
+    }
+    if (auto lock = access->m_lock) {
+      // A waiter may set the waiting bit while the lock is held.
+      auto s = lock->m_clock.load(std::memory_order_relaxed);
+      while (!lock->m_clock.compare_exchange_weak(s,
+                                                  t | (~s & waiting_bit),
+                                                  std::memory_order_release,
+                                                  std::memory_order_relaxed))
+        ;
     }
   } else {
     access->destroy();
   }
 }
 
-template <class Value>
+template <class Value, class Lock>
 trade_v1::Private::access_t<Value> *
 trade_v1::Private::insert(transaction_base_t *transaction,
-                          atom_t<Value> *atom) {
+                          atom_t<Value, Lock> *atom) {
+  if (!transaction->m_accesses) {
+    auto n = transaction->m_n_flat;
+    for (size_t i = 0; i < n; ++i) {
+      auto access = transaction->m_flat[i];
+      if (access->m_atom == atom)
+        return static_cast<access_t<Value> *>(access);
+    }
+    if (n < n_flat) {
+      auto access = alloc(transaction,
+                          alignof(access_of_t<Value>) - 1,
+                          sizeof(access_of_t<Value>));
+      if (!access)
+        abort_readonly(transaction);
+      access->m_children[0] = nullptr;
+      access->m_atom = atom;
+      access->m_state = INITIAL;
+      access->m_saved_in = 0;
+      access->m_lock = &atom->lock();
+      transaction->m_flat[n] = access;
+      transaction->m_n_flat = n + 1;
+      return static_cast<access_t<Value> *>(access);
+    }
+  }
   return static_cast<access_t<Value> *>(insert(transaction,
                                                atom,
-                                               alignof(access_t<Value>) - 1,
-                                               sizeof(access_t<Value>)));
+                                               &atom->lock(),
+                                               alignof(access_of_t<Value>) - 1,
+                                               sizeof(access_of_t<Value>)));
 }
 
-template <class Value>
-Value trade_v1::Private::load(const atom_t<Value> &atom) {
+template <class Value, class Lock>
+Value trade_v1::Private::load(const atom_t<Value, Lock> &atom) {
   auto transaction = s_transaction;
   if (transaction->m_alloc) {
-    auto access = insert(transaction, const_cast<atom_t<Value> *>(&atom));
+    auto access = insert(transaction, const_cast<atom_t<Value, Lock> *>(&atom));
+    if constexpr (!atom_t<Value, Lock>::is_atomic)
+      if (access->m_state & FIELDS)
+        widen(transaction, const_cast<atom_t<Value, Lock> &>(atom), access);
     if (access->m_state == INITIAL) {
-      access->m_destroy = destroy<Value>;
-      auto &lock = s_locks[access->m_lock_ix];
-      auto s = lock.m_clock.load();
-      if (transaction->m_start < s)
-        throw transaction;
+      access->m_destroy = destroy<Value, Lock>;
+      auto &lock = *access->m_lock;
+      auto s = transaction->m_irrevocable ? lock_irrevocably(lock)
+                                          : lock.m_clock.load();
+      if (transaction->m_start < (s & ~waiting_bit) &&
+          !holds(transaction, lock) && !extend(transaction, s))
+        abort_too_new(transaction, access->m_atom, lock, s);
       new (&access->m_current) Value(atom.m_value.load());
       access->m_state = READ;
       if (s != lock.m_clock.load())
-        throw transaction;
+        abort_changed(transaction, access->m_atom, lock);
     }
     return access->m_current;
   } else {
-    auto &lock = s_locks[lock_ix_of(&atom)];
+    auto &lock = atom.lock();
     auto s = lock.m_clock.load();
-    if (transaction->m_start < s)
-      throw transaction;
+    if (transaction->m_start < (s & ~waiting_bit)) {
+      if constexpr (atom_t<Value, Lock>::is_versioned)
+        if (transaction->m_snapshot)
+          return load_version(transaction, atom);
+      abort_too_new(transaction, &atom, lock, s);
+    }
     Value result = atom.m_value.load();
-    if (s != lock.m_clock.load())
-      throw transaction;
+    if (s != lock.m_clock.load()) {
+      if constexpr (atom_t<Value, Lock>::is_versioned)
+        if (transaction->m_snapshot)
+          return load_version(transaction, atom);
+      abort_changed(transaction, &atom, lock);
+    }
     return result;
   }
 }
 
-template <class Value>
-Value trade_v1::Private::unsafe_load(const atom_t<Value> &atom) {
-  if (Private::atom_t<Value>::is_atomic) {
+template <class Value, class Lock>
+Value trade_v1::Private::load_version(transaction_base_t *transaction,
+                                      const atom_t<Value, Lock> &atom) {
+  auto t = transaction->m_start;
+  auto &lock = atom.lock();
+  molecular::backoff backoff;
+  while (true) {
+    auto s = lock.m_clock.load();
+    if (is_held_irrevocably(s))
+      abort_too_new(transaction, &atom, lock, s);
+    if (0 <= static_cast<signed_clock_t>(s) && (s & ~waiting_bit) <= t) {
+      Value result = atom.m_value.load();
+      if (s == lock.m_clock.load())
+        return result;
+      continue;
+    }
+    for (auto &version : atom.m_versions) {
+      auto until = version.m_until.load(std::memory_order_acquire);
+      auto from = version.m_from.load(std::memory_order_relaxed);
+      if (from <= t && t < until) {
+        Value result = version.m_value.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (until == version.m_until.load(std::memory_order_relaxed) &&
+            from == version.m_from.load(std::memory_order_relaxed))
+          return result;
+      }
+    }
+    // A commit holding the lock may not yet have retained the version.
+    if (s == lock.m_clock.load() && 0 <= static_cast<signed_clock_t>(s))
+      abort_too_new(transaction, &atom, lock, s);
+    backoff();
+  }
+}
+
+template <class Value, class Lock>
+Value trade_v1::Private::unsafe_load(const atom_t<Value, Lock> &atom) {
+  if (Private::atom_t<Value, Lock>::is_atomic) {
     return atom.m_value.load(std::memory_order_relaxed);
   } else {
-    auto &lock = s_locks[lock_ix_of(&atom)];
+    auto &lock = atom.lock();
     molecular::backoff backoff;
     while (true) {
       auto s = lock.m_clock.load();
@@ -90,18 +202,32 @@ Value trade_v1::Private::unsafe_load(const atom_t<Value> &atom) {
   }
 }
 
-template <class Value, class Forwardable>
-Value &trade_v1::Private::store(atom_t<Value> &atom, Forwardable &&value) {
-  auto access = insert(s_transaction, &atom);
+template <class Value, class Lock, class Forwardable>
+Value &trade_v1::Private::store(atom_t<Value, Lock> &atom,
+                                Forwardable &&value) {
+  auto transaction = s_transaction;
+  auto access = insert(transaction, &atom);
+  if constexpr (!atom_t<Value, Lock>::is_atomic)
+    if (access->m_state & FIELDS)
+      widen(transaction, atom, access);
+  save(transaction, access);
   switch (access->m_state) {
   case INITIAL:
+    if (transaction->m_irrevocable)
+      lock_irrevocably(*access->m_lock);
     new (&access->m_current) Value(std::forward<Forwardable>(value));
-    access->m_destroy = destroy<Value>;
+    access->m_destroy = destroy<Value, Lock>;
     access->m_state = WRITTEN;
+    transaction->m_written = true;
+    if (transaction->m_encounter)
+      lock_on_encounter(transaction, access);
     break;
   case READ:
     access->retain_move();
     access->m_state = READ + WRITTEN;
+    transaction->m_written = true;
+    if (transaction->m_encounter)
+      lock_on_encounter(transaction, access);
     [[fallthrough]];
   default:
     access->m_current = std::forward<Forwardable>(value);
@@ -109,38 +235,346 @@ Value &trade_v1::Private::store(atom_t<Value> &atom, Forwardable &&value) {
   return access->m_current;
 }
 
-template <class Value> Value &trade_v1::Private::ref(atom_t<Value> &atom) {
+template <class Value, class Lock>
+Value &trade_v1::Private::ref(atom_t<Value, Lock> &atom) {
   auto transaction = s_transaction;
   auto access = insert(transaction, &atom);
+  if constexpr (!atom_t<Value, Lock>::is_atomic)
+    if (access->m_state & FIELDS)
+      widen(transaction, atom, access);
   switch (access->m_state) {
   case INITIAL: {
-    access->m_destroy = destroy<Value>;
-    auto &lock = s_locks[access->m_lock_ix];
-    auto s = lock.m_clock.load();
-    if (transaction->m_start < s)
-      throw transaction;
+    access->m_destroy = destroy<Value, Lock>;
+    auto &lock = *access->m_lock;
+    auto s = transaction->m_irrevocable ? lock_irrevocably(lock)
+                                        : lock.m_clock.load();
+    if (transaction->m_start < (s & ~waiting_bit) &&
+        !holds(transaction, lock) && !extend(transaction, s))
+      abort_too_new(transaction, access->m_atom, lock, s);
     new (&access->m_current) Value(atom.m_value.load());
     access->m_state = READ;
     if (s != lock.m_clock.load())
-      throw transaction;
+      abort_changed(transaction, access->m_atom, lock);
     [[fallthrough]];
   }
   case READ:
+    save(transaction, access);
     access->retain_copy();
     access->m_state = READ + WRITTEN;
+    transaction->m_written = true;
+    if (transaction->m_encounter)
+      lock_on_encounter(transaction, access);
+    break;
+  default:
+    save(transaction, access);
   }
   return access->m_current;
 }
 
+template <class Value, class Lock, class Field>
+Field trade_v1::Private::load(const atom_t<Value, Lock> &atom,
+                              Field Value::*member) {
+  if constexpr (atom_t<Value, Lock>::is_atomic) {
+    return load(atom).*member;
+  } else {
+    auto transaction = s_transaction;
+    if (transaction->m_alloc) {
+      auto access = insert_fields(transaction,
+                                  const_cast<atom_t<Value, Lock> *>(&atom));
+      if (!(access->m_state & FIELDS))
+        return access->m_current.*member;
+      auto offset = atom.m_value.offset_of(member);
+      if (auto field = find_field<Field>(access, offset))
+        return *field;
+      // The atom is marked as read only after the read so that extending the
+      // start time on the read does not check the atom itself.
+      auto result = read_field(transaction, atom, member);
+      access->m_state |= READ;
+      return result;
+    }
+    return read_field(transaction, atom, member);
+  }
+}
+
+template <class Value, class Lock, class Field, class Forwardable>
+void trade_v1::Private::store(atom_t<Value, Lock> &atom,
+                              Field Value::*member,
+                              Forwardable &&value) {
+  if constexpr (!atom_t<Value, Lock>::is_atomic) {
+    auto transaction = s_transaction;
+    // Writes within `or_else` alternatives are undone on the whole value.
+    if (!transaction->m_alternative) {
+      auto access = insert_fields(transaction, &atom);
+      if (access->m_state & FIELDS) {
+        auto offset = atom.m_value.offset_of(member);
+        if (auto field = find_field<Field>(access, offset))
+          *field = std::forward<Forwardable>(value);
+        else
+          add_field<Field>(
+              transaction, access, offset, std::forward<Forwardable>(value));
+        if (!(access->m_state & WRITTEN)) {
+          access->m_state |= WRITTEN;
+          transaction->m_written = true;
+          if (transaction->m_encounter)
+            lock_on_encounter(transaction, access);
+        }
+        return;
+      }
+    }
+  }
+  ref(atom).*member = std::forward<Forwardable>(value);
+}
+
+template <class Value, class Lock, class Field>
+Field &trade_v1::Private::ref(atom_t<Value, Lock> &atom,
+                              Field Value::*member) {
+  if constexpr (!atom_t<Value, Lock>::is_atomic) {
+    auto transaction = s_transaction;
+    if (!transaction->m_alternative) {
+      auto access = insert_fields(transaction, &atom);
+      if (access->m_state & FIELDS) {
+        auto offset = atom.m_value.offset_of(member);
+        auto field = find_field<Field>(access, offset);
+        if (!field) {
+          field = add_field<Field>(transaction,
+                                   access,
+                                   offset,
+                                   read_field(transaction, atom, member));
+          if (!(access->m_state & WRITTEN)) {
+            access->m_state |= READ + WRITTEN;
+            transaction->m_written = true;
+            if (transaction->m_encounter)
+              lock_on_encounter(transaction, access);
+          } else {
+            access->m_state |= READ;
+          }
+        }
+        return *field;
+      }
+    }
+  }
+  return ref(atom).*member;
+}
+
+template <class Value, class Lock>
+trade_v1::Private::access_fields_t<Value> *
+trade_v1::Private::insert_fields(transaction_base_t *transaction,
+                                 atom_t<Value, Lock> *atom) {
+  auto access =
+      static_cast<access_fields_t<Value> *>(insert(transaction, atom));
+  if (access->m_state == INITIAL) {
+    access->m_destroy = destroy<Value, Lock>;
+    if (transaction->m_irrevocable)
+      lock_irrevocably(*access->m_lock);
+    access->m_fields = nullptr;
+    access->m_state = FIELDS;
+  }
+  return access;
+}
+
+template <class Field, class Value>
+Field *trade_v1::Private::find_field(access_fields_t<Value> *access,
+                                     size_t offset) {
+  for (auto field = access->m_fields; field; field = field->m_next)
+    if (field->m_offset == offset)
+      return reinterpret_cast<Field *>(field + 1);
+  return nullptr;
+}
+
+template <class Field, class Value>
+Field *trade_v1::Private::add_field(transaction_base_t *transaction,
+                                    access_fields_t<Value> *access,
+                                    size_t offset,
+                                    const Field &value) {
+  static_assert(alignof(Field) <= alignof(field_t));
+  auto field = static_cast<field_t *>(static_cast<void *>(alloc(
+      transaction, alignof(field_t) - 1, sizeof(field_t) + sizeof(Field))));
+  if (!field)
+    abort_readonly(transaction);
+  field->m_next = access->m_fields;
+  field->m_offset = static_cast<uint32_t>(offset);
+  field->m_size = sizeof(Field);
+  access->m_fields = field;
+  return new (field + 1) Field(value);
+}
+
+template <class Value, class Lock, class Field>
+Field trade_v1::Private::read_field(transaction_base_t *transaction,
+                                    const atom_t<Value, Lock> &atom,
+                                    Field Value::*member) {
+  auto &lock = atom.lock();
+  auto s = lock.m_clock.load();
+  if (transaction->m_start < (s & ~waiting_bit) &&
+      !holds(transaction, lock) && !extend(transaction, s)) {
+    if constexpr (atom_t<Value, Lock>::is_versioned)
+      if (!transaction->m_alloc && transaction->m_snapshot)
+        return load_version(transaction, atom).*member;
+    abort_too_new(transaction, &atom, lock, s);
+  }
+  Field result = atom.m_value.load().*member;
+  if (s != lock.m_clock.load()) {
+    if constexpr (atom_t<Value, Lock>::is_versioned)
+      if (!transaction->m_alloc && transaction->m_snapshot)
+        return load_version(transaction, atom).*member;
+    abort_changed(transaction, &atom, lock);
+  }
+  return result;
+}
+
+template <class Value, class Lock>
+void trade_v1::Private::widen(transaction_base_t *transaction,
+                              atom_t<Value, Lock> &atom,
+                              access_t<Value> *access) {
+  auto &lock = *access->m_lock;
+  auto s = lock.m_clock.load();
+  if (transaction->m_start < (s & ~waiting_bit) &&
+      !holds(transaction, lock) && !extend(transaction, s))
+    abort_too_new(transaction, access->m_atom, lock, s);
+  new (&access->m_current) Value(atom.m_value.load());
+  if (s != lock.m_clock.load())
+    abort_changed(transaction, access->m_atom, lock);
+  for (auto field = static_cast<access_fields_t<Value> *>(access)->m_fields;
+       field;
+       field = field->m_next)
+    std::memcpy(reinterpret_cast<uint8_t *>(&access->m_current) +
+                    field->m_offset,
+                field + 1,
+                field->m_size);
+  access->m_state = READ | (access->m_state & WRITTEN);
+}
+
+template <class Value, class Lock>
+void trade_v1::Private::add(atom_t<Value, Lock> &atom, const Value &delta) {
+  auto transaction = s_transaction;
+  // Irrevocable transactions and transactions that lock on encounter hold the
+  // lock anyway, so adding blindly would gain nothing.
+  if (transaction->m_irrevocable || transaction->m_encounter) {
+    ref(atom) += delta;
+    return;
+  }
+  auto access = insert(transaction, &atom);
+  save(transaction, access);
+  switch (access->m_state) {
+  case INITIAL:
+    new (&access->m_current) Value(delta);
+    access->m_destroy = destroy<Value, Lock>;
+    access->m_state = WRITTEN + DELTA;
+    transaction->m_written = true;
+    break;
+  case READ:
+    access->m_state = READ + WRITTEN;
+    transaction->m_written = true;
+    [[fallthrough]];
+  default:
+    access->m_current += delta;
+  }
+}
+
+template <class Value, class Lock>
+Value trade_v1::Private::load_sum(const atom_t<Value, Lock> &atom) {
+  auto transaction = s_transaction;
+  if (transaction->m_alloc) {
+    auto access = insert(transaction, const_cast<atom_t<Value, Lock> *>(&atom));
+    if (access->m_state & DELTA) {
+      save(transaction, access);
+      auto &lock = *access->m_lock;
+      auto s = lock.m_clock.load();
+      if (transaction->m_start < (s & ~waiting_bit) && !extend(transaction, s))
+        abort_too_new(transaction, access->m_atom, lock, s);
+      access->m_current += atom.m_value.load();
+      access->m_state = READ + WRITTEN;
+      if (s != lock.m_clock.load())
+        abort_changed(transaction, access->m_atom, lock);
+    }
+  }
+  return load(atom);
+}
+
+template <class Value>
+void trade_v1::Private::save(transaction_base_t *transaction,
+                             access_t<Value> *access) {
+  auto alternative = transaction->m_alternative;
+  if (!alternative || access->m_saved_in == alternative->m_id)
+    return;
+  auto undo = static_cast<undo_t<Value> *>(static_cast<undo_base_t *>(
+      static_cast<void *>(alloc(transaction,
+                                alignof(undo_t<Value>) - 1,
+                                sizeof(undo_t<Value>)))));
+  if (!undo)
+    abort_readonly(transaction);
+  undo->m_access = access;
+  undo->m_state = access->m_state;
+  undo->m_saved_in = access->m_saved_in;
+  undo->m_undo = Private::undo<Value>;
+  if (INITIAL != access->m_state)
+    new (&undo->m_saved) Value(access->m_current);
+  undo->m_next = transaction->m_undo;
+  transaction->m_undo = undo;
+  access->m_saved_in = alternative->m_id;
+}
+
+template <class Value>
+void trade_v1::Private::undo(undo_base_t *undo_base, bool restore) {
+  auto undo = static_cast<undo_t<Value> *>(undo_base);
+  if (restore) {
+    auto access = static_cast<access_t<Value> *>(undo->m_access);
+    access->undo(undo->m_state, undo->m_saved);
+    access->m_saved_in = undo->m_saved_in;
+  }
+  if (INITIAL != undo->m_state)
+    undo->m_saved.~Value();
+}
+
+template <class First, class Second>
+std::invoke_result_t<First> trade_v1::Private::or_else(First &&first,
+                                                       Second &&second) {
+  using result_t = std::invoke_result_t<First>;
+  auto transaction = s_transaction;
+  if (!transaction) {
+    return atomically(stack<1024>, s_contention_policy, [&]() -> result_t {
+      return or_else(std::forward<First>(first), std::forward<Second>(second));
+    });
+  } else if constexpr (std::is_void_v<result_t>) {
+    auto body = [&]() { first(); };
+    if (!attempt_alternative(transaction, body))
+      second();
+  } else {
+    held_result_t<result_t> result;
+    auto body = [&]() { result.emplace(first); };
+    if (!attempt_alternative(transaction, body))
+      return second();
+    return result.take();
+  }
+}
+
 template <class Config, class Action>
-std::invoke_result_t<Action> trade_v1::Private::atomically(Config config,
-                                                           Action &&action) {
-  return s_transaction
-             ? std::forward<Action>(action)()
-             : run_t<std::conditional_t<std::is_same_v<Config, heap>,
-                                        transaction_heap_t,
-                                        transaction_stack_t<Config>>,
-                     std::invoke_result_t<Action>>::run(config,
-                                                        std::forward<Action>(
-                                                            action));
+std::invoke_result_t<Action> trade_v1::Private::atomically(
+    Config config, contention_policy policy, Action &&action) {
+  using result_t = std::invoke_result_t<Action>;
+  using runner_t = run_t<
+      std::conditional_t<
+          std::is_same_v<Config, heap>,
+          transaction_heap_t,
+          std::conditional_t<
+              std::is_same_v<Config, snapshot_t>,
+              transaction_snapshot_t,
+              std::conditional_t<
+                  std::is_same_v<Config, encounter_locking_t>,
+                  transaction_encounter_t,
+                  std::conditional_t<std::is_same_v<Config, irrevocable_t>,
+                                     transaction_irrevocable_t,
+                                     transaction_stack_t<Config>>>>>,
+      result_t>;
+  if (s_transaction)
+    return std::forward<Action>(action)();
+  commit_scope_t scope;
+  if constexpr (std::is_void_v<result_t>) {
+    runner_t::run(config, policy, std::forward<Action>(action));
+    scope.commit();
+  } else {
+    result_t result =
+        runner_t::run(config, policy, std::forward<Action>(action));
+    scope.commit();
+    return std::forward<result_t>(result);
+  }
 }
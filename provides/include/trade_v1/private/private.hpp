@@ -4,26 +4,173 @@
 
 #include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Build time configuration of the lock table:
+//
+// - `TRADE_V1_LOCK_HASH` selects the function used to map addresses of atoms
+//   to lock indices and must be either `modulo` or `fibonacci`.  `modulo` takes
+//   the address modulo table size.  `fibonacci` uses multiplicative hashing and
+//   requires the table size to be a power of two.
+//
+// - `TRADE_V1_LOCK_TABLE_SIZE` selects the number of locks.  Defaults to
+//   131071 with `modulo` hashing and 131072 with `fibonacci` hashing.
+//
+// - `TRADE_V1_LOCK_ALIGN` selects the alignment of locks in bytes.  Each lock
+//   takes 16 bytes by default.  Specifying a cache line size, e.g. 64, avoids
+//   false sharing between locks at the cost of more memory.
+//
+// These must be defined consistently for every translation unit that includes
+// Trade.C++ headers, including the library itself.
+//
+// Build time configuration of transaction aborts:
+//
+// - `TRADE_V1_ABORT_LONGJMP` selects whether aborted transactions are restarted
+//   by throwing an exception (`0`) or by `longjmp` (`1`).  Defaults to `1` when
+//   exceptions are disabled and to `0` otherwise.  With `longjmp` no
+//   destructors of objects local to the transaction are run on abort.  This
+//   must also be defined consistently.
+//
+// Build time configuration of statistics:
+//
+// - `TRADE_V1_STATS` selects whether counts of transaction events are collected
+//   per thread for `get_stats` (`1`) or not (`0`).  Defaults to `0`, in which
+//   case no counting code is compiled into transactions.  This must also be
+//   defined consistently.
+//
+// - `TRADE_V1_PROFILE` selects whether conflicts are recorded per atom and lock
+//   for `get_hot_spots` (`1`) or not (`0`).  Defaults to `0`, in which case no
+//   profiling code is compiled into transactions.  This must also be defined
+//   consistently.
+
+#ifndef TRADE_V1_EXCEPTIONS
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define TRADE_V1_EXCEPTIONS 1
+#else
+#define TRADE_V1_EXCEPTIONS 0
+#endif
+#endif
+
+#ifndef TRADE_V1_ABORT_LONGJMP
+#define TRADE_V1_ABORT_LONGJMP !TRADE_V1_EXCEPTIONS
+#endif
+
+#ifndef TRADE_V1_STATS
+#define TRADE_V1_STATS 0
+#endif
+
+#ifndef TRADE_V1_PROFILE
+#define TRADE_V1_PROFILE 0
+#endif
+
+#ifndef TRADE_V1_LOCK_HASH
+#define TRADE_V1_LOCK_HASH modulo
+#endif
+
+#ifndef TRADE_V1_LOCK_ALIGN
+#define TRADE_V1_LOCK_ALIGN 16
+#endif
 
 namespace trade_v1 {
 
-template <class Value> struct atom;
+struct hashed_lock;
+struct inline_lock;
+class lock_group;
+template <class Lock, size_t Depth> struct versioned;
+
+template <class Value, class Lock = hashed_lock> struct atom;
+
+enum class clock_scheme;
+
+void set_clock_scheme(clock_scheme scheme);
+
+enum class contention_policy;
+
+void set_contention_policy(contention_policy policy);
+
+struct irrevocable_t;
+
+struct snapshot_t;
+
+struct encounter_locking_t;
+
+void set_escalation_threshold(uint32_t n_aborts);
+
+enum class abort_reason;
+
+struct stats;
+
+stats get_stats();
+
+void reset_stats();
+
+struct hot_spot;
+
+std::vector<hot_spot> get_hot_spots();
+
+void dump_hot_spots(FILE *file, size_t max_rows);
+
+void reset_hot_spots();
 
 template <class Config, class Action>
 std::invoke_result_t<Action> atomically(Config config, Action &&action);
 
+template <class Config, class Action>
+std::invoke_result_t<Action>
+atomically(Config config, contention_policy policy, Action &&action);
+
 [[noreturn]] void retry();
 
+template <class First, class Second>
+std::invoke_result_t<First> or_else(First &&first, Second &&second);
+
+template <class Value> size_t lock_index_of(const atom<Value> &atom);
+
+template <class Key, class Value, class Hash, class Equal> class hash_map_tm;
+template <class Value, size_t Shards> class counter;
+
 /// Private implementation details.
 class Private {
-  template <class> friend struct atom;
+  template <class, class> friend struct atom;
+  template <class, size_t> friend class counter;
+  friend class lock_group;
 
   template <class Config, class Action>
   friend std::invoke_result_t<Action> atomically(Config config,
                                                  Action &&action);
 
+  template <class Config, class Action>
+  friend std::invoke_result_t<Action>
+  atomically(Config config, contention_policy policy, Action &&action);
+
   friend void retry();
 
+  template <class First, class Second>
+  friend std::invoke_result_t<First> or_else(First &&first, Second &&second);
+
+  friend void after_commit(void (*action)(void *context), void *context);
+
+  friend void set_clock_scheme(clock_scheme scheme);
+
+  friend void set_contention_policy(contention_policy policy);
+
+  friend void set_escalation_threshold(uint32_t n_aborts);
+
+  friend stats get_stats();
+
+  friend void reset_stats();
+
+  friend std::vector<hot_spot> get_hot_spots();
+
+  friend void dump_hot_spots(FILE *file, size_t max_rows);
+
+  friend void reset_hot_spots();
+
+  template <class Value>
+  friend size_t lock_index_of(const atom<Value> &atom);
+
   //
 
   struct Static;
@@ -32,10 +179,27 @@ class Private {
 
   template <class Value> class non_atomic_t;
 
+  // Values that are not lock free are stored non-atomically and read
+  // optimistically under the lock clock like under a sequence lock.
+  template <class Value>
+  static constexpr bool is_atomic_v =
+      !std::is_trivially_copyable_v<Value> ||
+      std::atomic<Value>::is_always_lock_free;
+
+  template <class Value>
+  using cell_t = std::conditional_t<is_atomic_v<Value>,
+                                    std::atomic<Value>,
+                                    non_atomic_t<Value>>;
+
   //
 
   class atom_mono_t;
-  template <class Value> class atom_t;
+  template <class Lock> class atom_lock_t;
+  template <class Value, class Lock> class atom_history_t;
+  template <class Value, class Lock> class atom_t;
+
+  // Index of the current thread for picking a counter shard.
+  static size_t thread_index();
 
   //
 
@@ -47,16 +211,95 @@ class Private {
   using signed_clock_t = int64_t;
   using lock_ix_t = int32_t;
 
-  static constexpr lock_ix_t n_locks = 131071;
+  enum class lock_hash_t { modulo, fibonacci };
+
+  static constexpr lock_hash_t lock_hash = lock_hash_t::TRADE_V1_LOCK_HASH;
+
+#ifdef TRADE_V1_LOCK_TABLE_SIZE
+  static constexpr lock_ix_t n_locks = TRADE_V1_LOCK_TABLE_SIZE;
+#else
+  static constexpr lock_ix_t n_locks =
+      lock_hash == lock_hash_t::modulo ? 131071 : 131072;
+#endif
+
+  static_assert(0 < n_locks);
+  static_assert(lock_hash == lock_hash_t::modulo ||
+                    (1 < n_locks && 0 == (n_locks & (n_locks - 1))),
+                "fibonacci hashing requires a power of two table size");
+
   static lock_t s_locks[n_locks];
 
   static std::atomic<clock_t> s_clock;
+  static clock_scheme s_clock_scheme;
+
+  static contention_policy s_contention_policy;
+
+  // Maximum number of backoff rounds to wait for a lock held by another
+  // transaction at commit with the `spin` and `scaled_spin` policies, and
+  // before restarting a transaction locking on encounter that found a lock
+  // held.
+  static constexpr uint32_t n_spin_rounds = 8, n_scaled_spin_rounds = 32,
+                            n_encounter_rounds = 64;
+
+  static uint32_t s_escalation_threshold;
+
+  // Number of aborts after which a transaction with the `priority` policy
+  // publishes its ticket as the oldest transaction.
+  static constexpr uint32_t n_priority_aborts = 3;
+
+  // A lock held by the irrevocable transaction has the sign bit set, like a
+  // lock held by a committing transaction, but the next bit clear, unlike
+  // `~clock`.  Other transactions see such a lock simply as held.
+  static constexpr clock_t irrevocable_bit = clock_t(1) << 63;
+
+  // A lock whose list of waiters may be non-empty has this bit set.  The bit
+  // is inverted along with the rest of the clock while the lock is held by a
+  // committing transaction and is ignored when comparing versions.
+  static constexpr clock_t waiting_bit = clock_t(1) << 61;
+
+  static bool is_held_irrevocably(clock_t s);
+
+  static constexpr bool counting = TRADE_V1_STATS;
+
+  // Counts of the current thread laid out like `stats`.  Only written by the
+  // thread itself.  Null until the thread starts its first transaction.
+  thread_local static std::atomic<uint64_t> *s_counts;
+
+  static void count(size_t offset, uint64_t n = 1);
+  static void count_abort(abort_reason reason);
+  static void count_start();
+
+  // Counts an abort by an exception escaping the transaction, which also ends
+  // the wakeup of a preceding `retry`.
+  static void count_user_exception();
+
+  static constexpr bool profiling = TRADE_V1_PROFILE;
+
+  // Records a conflict on the given atom of a transaction started at `t` and
+  // the write of the given atom at version `u` once the commit can no longer
+  // fail.  A conflict is attributed to the atom itself if the atom has been
+  // written since `t` and to a collision otherwise.
+  static void
+  profile_conflict(const atom_mono_t *atom, const lock_t &lock, clock_t t);
+  static void profile_write(const atom_mono_t *atom, clock_t u);
 
   //
 
   using state_t = uint8_t;
   static constexpr state_t INITIAL = 0, READ = 1, WRITTEN = 2;
 
+  // An access in state `WRITTEN + DELTA` holds a delta to add to the atom on
+  // commit and has not read the atom.  Its lock is acquired on commit
+  // regardless of the version, so such blind adds do not conflict with each
+  // other.  Only counters add.
+  static constexpr state_t DELTA = 4;
+
+  // An access in state `FIELDS` to an atom with a non-atomic value has not
+  // copied the value.  Members of the value written by the transaction are
+  // logged separately and only those are written back on commit.  Accessing
+  // the whole value first copies the value and applies the logged members.
+  static constexpr state_t FIELDS = 8;
+
   struct access_base_t;
 
   template <class Value,
@@ -64,55 +307,247 @@ class Private {
                 std::is_trivially_destructible_v<Value>>
   struct access_t;
 
+  struct field_t;
+  template <class Value> struct access_fields_t;
+
+  // Accesses to atoms with non-atomic values have room for logged members.
+  template <class Value>
+  using access_of_t = std::conditional_t<is_atomic_v<Value>,
+                                         access_t<Value>,
+                                         access_fields_t<Value>>;
+
   using destroy_t = void (*)(clock_t t, access_base_t *self);
 
-  template <class Value> static void destroy(clock_t t, access_base_t *access);
+  template <class Value, class Lock>
+  static void destroy(clock_t t, access_base_t *access);
+
+  // Writes within the first alternative of `or_else` save the previous state
+  // of the access in an undo record, at most once per alternative, so that
+  // the writes can be undone if the alternative calls `retry`.  Reads are kept.
+
+  struct undo_base_t;
+  template <class Value> struct undo_t;
+
+  using undo_fn_t = void (*)(undo_base_t *self, bool restore);
+
+  template <class Value> static void undo(undo_base_t *self, bool restore);
 
   //
 
+  // Up to `n_flat` accesses are kept in an unordered array searched linearly.
+  // Larger access sets are kept in a splay tree.
+  static constexpr size_t n_flat = 8;
+
+  struct alternative_t;
   struct transaction_base_t;
   struct transaction_heap_t;
+  struct transaction_snapshot_t;
+  struct transaction_encounter_t;
+  struct transaction_irrevocable_t;
   template <class Config> struct transaction_stack_t;
 
   thread_local static transaction_base_t *s_transaction;
 
+  // Actions registered by `after_commit` during the current attempt of the
+  // outermost transaction of the thread are at indices from
+  // `s_commit_hooks_begin` to `s_n_commit_hooks` of a per-thread array.  An
+  // attempt starts by dropping the actions of previous attempts.
+  thread_local static size_t s_commit_hooks_begin, s_n_commit_hooks;
+
+  // Scope of the outermost transaction, which runs the registered actions on
+  // `commit` and drops them when left otherwise.
+  struct commit_scope_t;
+
+  static void add_commit_hook(void (*action)(void *context), void *context);
+  static void run_commit_hooks();
+
+  // Publishes the ticket of the transaction, taken on the first call, as the
+  // oldest transaction unless an older ticket is published.
+  static void claim_priority(transaction_base_t *transaction);
+
+  // Withdraws the ticket of the transaction if it is published.
+  static void release_priority(transaction_base_t *transaction);
+
   //
 
   template <class Transaction, class Result> struct run_t;
 
+  // Holds the result of an action run through `attempt` or
+  // `attempt_alternative` until it is returned.
+  template <class Result> class held_result_t;
+
+  [[noreturn]] static void abort(transaction_base_t *transaction,
+                                 abort_reason reason);
+
+  // Aborts a transaction assumed to be read-only, which has no log at all, on
+  // its first attempt to allocate from the log.  Other logs grow instead.
+  [[noreturn]] static void abort_readonly(transaction_base_t *transaction);
+
+  [[noreturn]] static void abort_changed(transaction_base_t *transaction,
+                                         const atom_mono_t *atom,
+                                         const lock_t &lock);
+
+#if TRADE_V1_ABORT_LONGJMP
+  static bool attempt(transaction_base_t *transaction,
+                      bool (*body)(void *context),
+                      void *context);
+
+  template <class Body>
+  static bool attempt(transaction_base_t *transaction, Body &body);
+#endif
+
   static lock_ix_t lock_ix_of(const atom_mono_t *atom);
 
-  static void signal(waiter_t *work);
+  template <class Value>
+  static lock_ix_t lock_ix_of(const atom_t<Value, hashed_lock> &atom);
+
+  static access_base_t *
+  alloc(transaction_base_t *transaction, size_t align_m1, size_t size);
+
+  static access_base_t *
+  alloc_chunk(transaction_base_t *transaction, size_t align_m1, size_t size);
+
+  // Logs that do not fit in the initial space of a transaction continue in
+  // chunks taken from a list kept per thread.  Chunks persist across
+  // transactions, so allocation only happens when a log grows beyond any
+  // previous log of the thread.
+  struct chunk_t;
+
+  // Switches the log of the transaction to the chunk following the current
+  // one, or the first chunk, adding a chunk of at least `size` bytes to the
+  // list unless the chunk is large enough.
+  static void next_chunk(transaction_base_t *transaction, size_t size);
+
+  // Locks acquired on encounter are recorded in the log so that the
+  // transaction can recognize them as its own and release them on abort.
+  struct locked_t;
+
+  // Acquires the lock of an atom on its first write by a transaction that
+  // locks on encounter.  Aborts if the lock is held by another transaction or
+  // is newer than the start of the transaction.
+  static void lock_on_encounter(transaction_base_t *transaction,
+                                access_base_t *access);
+
+  static bool holds(const transaction_base_t *transaction, const lock_t &lock);
+
+  static void enter_irrevocable(transaction_base_t *transaction);
+  static void leave_irrevocable(transaction_base_t *transaction);
+
+  static clock_t lock_irrevocably(lock_t &lock);
 
   static access_base_t *insert(transaction_base_t *transaction,
                                atom_mono_t *atom,
+                               lock_t *lock,
                                size_t align_m1,
                                size_t size);
 
-  template <class Value>
+  template <class Value, class Lock>
   static access_t<Value> *insert(transaction_base_t *transaction,
-                                 atom_t<Value> *atom);
+                                 atom_t<Value, Lock> *atom);
 
   static void destroy(transaction_base_t *transaction);
 
   static bool try_commit(transaction_base_t *transaction);
 
+  [[noreturn]] static void abort_too_new(transaction_base_t *transaction,
+                                         const atom_mono_t *atom,
+                                         const lock_t &lock,
+                                         clock_t s);
+
+  // Tries to move the start time of a transaction with a log past the version
+  // `s` of a lock instead of aborting.  Succeeds when no atom read so far has
+  // been changed since the start.
+  static bool extend(transaction_base_t *transaction, clock_t s);
+
   //
 
-  template <class Value> static Value load(const atom_t<Value> &atom);
+  template <class Value, class Lock>
+  static Value load(const atom_t<Value, Lock> &atom);
+
+  // Loads the version of a versioned atom that was current at the start of a
+  // snapshot transaction.
+  template <class Value, class Lock>
+  static Value load_version(transaction_base_t *transaction,
+                            const atom_t<Value, Lock> &atom);
+
+  template <class Value, class Lock>
+  static Value unsafe_load(const atom_t<Value, Lock> &atom);
+
+  template <class Value, class Lock, class Forwardable>
+  static Value &store(atom_t<Value, Lock> &atom, Forwardable &&value);
+
+  template <class Value, class Lock>
+  static Value &ref(atom_t<Value, Lock> &atom);
+
+  // Accesses to members of the value of an atom.  With a non-atomic value
+  // only the accessed members are copied.
 
-  template <class Value> static Value unsafe_load(const atom_t<Value> &atom);
+  template <class Value, class Lock, class Field>
+  static Field load(const atom_t<Value, Lock> &atom, Field Value::*member);
 
-  template <class Value, class Forwardable>
-  static Value &store(atom_t<Value> &atom, Forwardable &&value);
+  template <class Value, class Lock, class Field, class Forwardable>
+  static void
+  store(atom_t<Value, Lock> &atom, Field Value::*member, Forwardable &&value);
 
-  template <class Value> static Value &ref(atom_t<Value> &atom);
+  template <class Value, class Lock, class Field>
+  static Field &ref(atom_t<Value, Lock> &atom, Field Value::*member);
+
+  // Returns the access to the atom, which is in state `FIELDS` unless the
+  // whole value has already been accessed.
+  template <class Value, class Lock>
+  static access_fields_t<Value> *insert_fields(transaction_base_t *transaction,
+                                               atom_t<Value, Lock> *atom);
+
+  template <class Field, class Value>
+  static Field *find_field(access_fields_t<Value> *access, size_t offset);
+
+  template <class Field, class Value>
+  static Field *add_field(transaction_base_t *transaction,
+                          access_fields_t<Value> *access,
+                          size_t offset,
+                          const Field &value);
+
+  // Reads the member directly from the atom like `load` reads the value.
+  template <class Value, class Lock, class Field>
+  static Field read_field(transaction_base_t *transaction,
+                          const atom_t<Value, Lock> &atom,
+                          Field Value::*member);
+
+  // Switches an access in state `FIELDS` to an access to the whole value.
+  template <class Value, class Lock>
+  static void widen(transaction_base_t *transaction,
+                    atom_t<Value, Lock> &atom,
+                    access_t<Value> *access);
+
+  template <class Value, class Lock>
+  static void add(atom_t<Value, Lock> &atom, const Value &delta);
+
+  // Like `load`, but also reads the atom if the transaction has only added
+  // to it so far.
+  template <class Value, class Lock>
+  static Value load_sum(const atom_t<Value, Lock> &atom);
+
+  template <class Value>
+  static void save(transaction_base_t *transaction, access_t<Value> *access);
 
   template <class Config, class Action>
-  static std::invoke_result_t<Action> atomically(Config config,
-                                                 Action &&action);
+  static std::invoke_result_t<Action>
+  atomically(Config config, contention_policy policy, Action &&action);
 
   [[noreturn]] static void retry(transaction_base_t *transaction);
+
+  // Runs the body as the first alternative of `or_else` and returns whether
+  // it completed.  Returns false after undoing the writes of the body if it
+  // called `retry`.
+  static bool attempt_alternative(transaction_base_t *transaction,
+                                  void (*body)(void *context),
+                                  void *context);
+
+  template <class Body>
+  static bool attempt_alternative(transaction_base_t *transaction, Body &body);
+
+  template <class First, class Second>
+  static std::invoke_result_t<First> or_else(First &&first, Second &&second);
 };
 
 } // namespace trade_v1
@@ -7,38 +7,119 @@
 
 #include "dumpster_v1/finally.hpp"
 
+#if TRADE_V1_ABORT_LONGJMP
+
 template <class Transaction, class Result>
 template <class Config, class Action>
-Result trade_v1::Private::run_t<Transaction, Result>::run(Config config,
-                                                          Action &&action) {
+Result trade_v1::Private::run_t<Transaction, Result>::run(
+    Config config, contention_policy policy, Action &&action) {
   Transaction transaction(config);
+  transaction.m_policy = policy;
+  held_result_t<Result> result;
+  auto body = [&]() {
+    result.emplace(action);
+    return try_commit(&transaction);
+  };
   while (true) {
+    transaction.start();
+    if constexpr (counting)
+      count_start();
+    if (attempt(&transaction, body))
+      return result.take();
+    if constexpr (std::is_same_v<Transaction, transaction_irrevocable_t>)
+      transaction.contend();
+    else if (transaction.contend())
+      return run_t<transaction_irrevocable_t, Result>::run(
+          irrevocable_t{}, policy, action);
+  }
+}
+
+template <class Transaction>
+template <class Config, class Action>
+void trade_v1::Private::run_t<Transaction, void>::run(
+    Config config, contention_policy policy, Action &&action) {
+  Transaction transaction(config);
+  transaction.m_policy = policy;
+  auto body = [&]() {
+    action();
+    return try_commit(&transaction);
+  };
+  while (true) {
+    transaction.start();
+    if constexpr (counting)
+      count_start();
+    if (attempt(&transaction, body))
+      return;
+    if constexpr (std::is_same_v<Transaction, transaction_irrevocable_t>)
+      transaction.contend();
+    else if (transaction.contend())
+      return run_t<transaction_irrevocable_t, void>::run(
+          irrevocable_t{}, policy, action);
+  }
+}
+
+#else
+
+template <class Transaction, class Result>
+template <class Config, class Action>
+Result trade_v1::Private::run_t<Transaction, Result>::run(
+    Config config, contention_policy policy, Action &&action) {
+  Transaction transaction(config);
+  transaction.m_policy = policy;
+  while (true) {
+    transaction.start();
+    if constexpr (counting)
+      count_start();
     try {
-      transaction.start();
       auto destroy_accesses =
           dumpster::finally([&]() { destroy(&transaction); });
       Result result = action();
       if (try_commit(&transaction))
         return result;
     } catch (transaction_base_t *) {
+#if TRADE_V1_STATS
+    } catch (...) {
+      count_user_exception();
+      throw;
+#endif
     }
+    if constexpr (std::is_same_v<Transaction, transaction_irrevocable_t>)
+      transaction.contend();
+    else if (transaction.contend())
+      return run_t<transaction_irrevocable_t, Result>::run(
+          irrevocable_t{}, policy, action);
   }
 }
 
 template <class Transaction>
 template <class Config, class Action>
-void trade_v1::Private::run_t<Transaction, void>::run(Config config,
-                                                      Action &&action) {
+void trade_v1::Private::run_t<Transaction, void>::run(
+    Config config, contention_policy policy, Action &&action) {
   Transaction transaction(config);
+  transaction.m_policy = policy;
   while (true) {
+    transaction.start();
+    if constexpr (counting)
+      count_start();
     try {
-      transaction.start();
       auto destroy_accesses =
           dumpster::finally([&]() { destroy(&transaction); });
       action();
       if (try_commit(&transaction))
         return;
     } catch (transaction_base_t *) {
+#if TRADE_V1_STATS
+    } catch (...) {
+      count_user_exception();
+      throw;
+#endif
     }
+    if constexpr (std::is_same_v<Transaction, transaction_irrevocable_t>)
+      transaction.contend();
+    else if (transaction.contend())
+      return run_t<transaction_irrevocable_t, void>::run(
+          irrevocable_t{}, policy, action);
   }
 }
+
+#endif
@@ -2,13 +2,40 @@
 
 #include "trade_v1/private/private.hpp"
 
+#include <optional>
+
 template <class Transaction, class Result> struct trade_v1::Private::run_t {
   template <class Config, class Action>
-  static Result run(Config config, Action &&action);
+  static Result run(Config config, contention_policy policy, Action &&action);
 };
 
 template <class Transaction>
 struct trade_v1::Private::run_t<Transaction, void> {
   template <class Config, class Action>
-  static void run(Config config, Action &&action);
+  static void run(Config config, contention_policy policy, Action &&action);
+};
+
+// References are held by address, as `std::optional` cannot hold references.
+template <class Result> class trade_v1::Private::held_result_t {
+  std::optional<std::conditional_t<std::is_reference_v<Result>,
+                                   std::remove_reference_t<Result> *,
+                                   Result>>
+      m_value;
+
+public:
+  template <class Action> void emplace(Action &action) {
+    if constexpr (std::is_reference_v<Result>) {
+      Result result = action();
+      m_value.emplace(&result);
+    } else {
+      m_value.emplace(action());
+    }
+  }
+
+  Result take() {
+    if constexpr (std::is_reference_v<Result>)
+      return static_cast<Result>(**m_value);
+    else
+      return std::move(*m_value);
+  }
 };
@@ -2,45 +2,208 @@
 
 #include "trade_v1/private/transaction.hpp"
 
+inline trade_v1::Private::commit_scope_t::commit_scope_t()
+    : m_outer_begin(s_commit_hooks_begin) {
+  s_commit_hooks_begin = s_n_commit_hooks;
+}
+
+inline trade_v1::Private::commit_scope_t::~commit_scope_t() {
+  s_n_commit_hooks = s_commit_hooks_begin;
+  s_commit_hooks_begin = m_outer_begin;
+}
+
+inline void trade_v1::Private::commit_scope_t::commit() {
+  if (s_commit_hooks_begin != s_n_commit_hooks)
+    run_commit_hooks();
+}
+
 inline trade_v1::Private::transaction_base_t::~transaction_base_t() {
+  if (m_ticket)
+    release_priority(this);
   s_transaction = nullptr;
 }
 
-inline trade_v1::Private::transaction_base_t::transaction_base_t() {
+inline trade_v1::Private::transaction_base_t::transaction_base_t()
+    : m_chunk(nullptr),
+      m_irrevocable(false),
+      m_snapshot(false),
+      m_encounter(false),
+      m_n_aborts(0),
+      m_ticket(0) {
   s_transaction = this;
 }
 
+inline bool trade_v1::Private::transaction_base_t::contend() {
+  m_n_aborts += 1;
+  if (m_policy == contention_policy::backoff)
+    m_backoff();
+  else if (m_policy == contention_policy::priority &&
+           n_priority_aborts <= m_n_aborts)
+    claim_priority(this);
+  return s_escalation_threshold && s_escalation_threshold <= m_n_aborts;
+}
+
+inline void trade_v1::Private::count(size_t offset, uint64_t n) {
+  if constexpr (counting) {
+    if (auto counts = s_counts) {
+      auto &count = counts[offset / sizeof(uint64_t)];
+      count.store(count.load(std::memory_order_relaxed) + n,
+                  std::memory_order_relaxed);
+    }
+  }
+}
+
+inline void trade_v1::Private::count_abort(abort_reason reason) {
+  count(offsetof(stats, n_aborts) +
+        sizeof(uint64_t) * static_cast<size_t>(reason));
+}
+
+inline void trade_v1::Private::abort(transaction_base_t *transaction,
+                                     abort_reason reason) {
+  if constexpr (counting)
+    count_abort(reason);
+#if TRADE_V1_ABORT_LONGJMP
+  std::longjmp(transaction->m_restart, 1);
+#else
+  throw transaction;
+#endif
+}
+
+inline trade_v1::Private::access_base_t *
+trade_v1::Private::alloc(transaction_base_t *transaction,
+                         size_t align_m1,
+                         size_t size) {
+  auto begin = transaction->m_alloc;
+  auto start = (reinterpret_cast<size_t>(begin) + align_m1) & ~align_m1;
+  if ((transaction->m_alloc = reinterpret_cast<uint8_t *>(start + size)) <=
+      transaction->m_limit) {
+    if constexpr (counting) {
+      count(offsetof(stats, n_accesses));
+      count(offsetof(stats, n_log_bytes), transaction->m_alloc - begin);
+    }
+    return reinterpret_cast<access_base_t *>(start);
+  }
+  // A transaction assumed to be read-only has no log at all.
+  return transaction->m_limit ? alloc_chunk(transaction, align_m1, size)
+                              : nullptr;
+}
+
+inline void trade_v1::Private::abort_readonly(transaction_base_t *transaction) {
+  abort(transaction, abort_reason::readonly_escalation);
+}
+
+inline void trade_v1::Private::abort_changed(transaction_base_t *transaction,
+                                             const atom_mono_t *atom,
+                                             const lock_t &lock) {
+  if constexpr (profiling)
+    profile_conflict(atom, lock, transaction->m_start);
+  abort(transaction, abort_reason::changed);
+}
+
+inline bool trade_v1::Private::holds(const transaction_base_t *transaction,
+                                     const lock_t &lock) {
+  for (auto locked = transaction->m_locked; locked; locked = locked->m_next)
+    if (locked->m_lock == &lock)
+      return true;
+  return false;
+}
+
+inline bool trade_v1::Private::is_held_irrevocably(clock_t s) {
+  return (s >> 62) == 2;
+}
+
+#if TRADE_V1_ABORT_LONGJMP
+template <class Body>
+bool trade_v1::Private::attempt(transaction_base_t *transaction, Body &body) {
+  return attempt(
+      transaction,
+      [](void *context) { return (*static_cast<Body *>(context))(); },
+      &body);
+}
+#endif
+
+template <class Body>
+bool trade_v1::Private::attempt_alternative(transaction_base_t *transaction,
+                                            Body &body) {
+  return attempt_alternative(
+      transaction,
+      [](void *context) { (*static_cast<Body *>(context))(); },
+      &body);
+}
+
 inline trade_v1::Private::transaction_heap_t::transaction_heap_t(
     heap initial_size)
-    : m_block(initial_size ? new uint8_t[initial_size] : nullptr) {
-  m_alloc = m_limit = m_block.get() + initial_size;
+    : m_initial_size(initial_size) {
+  m_alloc = m_limit = nullptr;
 }
 
 inline void trade_v1::Private::transaction_heap_t::start() {
-  if (m_limit < m_alloc) {
-    size_t size = (m_limit - m_block.get()) * 2;
-    if (size < 8 * sizeof(access_t<size_t>))
-      size = 8 * sizeof(access_t<size_t>);
-    m_block.reset(new uint8_t[size]);
-    m_limit = m_block.get() + size;
+  // A transaction assumed to be read-only gets a log once it has attempted to
+  // allocate from the log, which leaves `m_alloc` non-null.
+  if (m_initial_size || m_alloc) {
+    m_chunk = nullptr;
+    next_chunk(this, m_initial_size);
   }
 
   m_accesses = nullptr;
-  m_alloc = m_block.get();
+  m_n_flat = 0;
+  m_written = false;
+  m_alternative = nullptr;
+  m_undo = nullptr;
+  m_locked = nullptr;
+  m_n_alternatives = 0;
+  s_n_commit_hooks = s_commit_hooks_begin;
   m_start = s_clock;
 }
 
 template <size_t Bytes>
 trade_v1::Private::transaction_stack_t<
-    trade_v1::stack_t<Bytes>>::transaction_stack_t(trade_v1::stack_t<Bytes>) {
-  m_alloc = m_limit = m_space + sizeof(m_space);
-}
+    trade_v1::stack_t<Bytes>>::transaction_stack_t(trade_v1::stack_t<Bytes>) {}
 
 template <size_t Bytes>
 void trade_v1::Private::transaction_stack_t<trade_v1::stack_t<Bytes>>::start() {
-  if (m_limit < m_alloc)
-    throw std::bad_alloc();
   m_accesses = nullptr;
+  m_n_flat = 0;
+  m_written = false;
+  m_alternative = nullptr;
+  m_undo = nullptr;
+  m_locked = nullptr;
+  m_n_alternatives = 0;
+  s_n_commit_hooks = s_commit_hooks_begin;
   m_alloc = m_space;
+  m_limit = m_space + sizeof(m_space);
+  m_chunk = nullptr;
   m_start = s_clock;
 }
+
+inline trade_v1::Private::transaction_snapshot_t::transaction_snapshot_t(
+    snapshot_t)
+    : transaction_heap_t(assume_readonly) {
+  m_snapshot = true;
+}
+
+inline trade_v1::Private::transaction_encounter_t::transaction_encounter_t(
+    encounter_locking_t)
+    : transaction_heap_t(heap(1024)) {
+  m_encounter = true;
+}
+
+inline trade_v1::Private::transaction_irrevocable_t::transaction_irrevocable_t(
+    irrevocable_t) {}
+
+inline void trade_v1::Private::transaction_irrevocable_t::start() {
+  enter_irrevocable(this);
+
+  m_chunk = nullptr;
+  next_chunk(this, 0);
+
+  m_accesses = nullptr;
+  m_n_flat = 0;
+  m_written = false;
+  m_alternative = nullptr;
+  m_undo = nullptr;
+  m_locked = nullptr;
+  m_n_alternatives = 0;
+  s_n_commit_hooks = s_commit_hooks_begin;
+  m_start = ~clock_t(0);
+}
@@ -2,23 +2,84 @@
 
 #include "trade_v1/private/access.hpp"
 
+#include "trade_v1/config.hpp"
 #include "trade_v1/synopsis.hpp"
 
-#include <memory>
+#include "molecular_v1/backoff.hpp"
+
+#if TRADE_V1_ABORT_LONGJMP
+#include <csetjmp>
+#endif
+
+struct trade_v1::Private::locked_t {
+  locked_t *m_next;
+  lock_t *m_lock;
+};
+
+struct trade_v1::Private::alternative_t {
+  alternative_t *m_outer;
+  undo_base_t *m_undo;
+  locked_t *m_locked;
+  size_t m_n_commit_hooks;
+  bool m_written;
+  uint32_t m_id;
+#if TRADE_V1_ABORT_LONGJMP
+  std::jmp_buf m_retry;
+#endif
+};
+
+struct trade_v1::Private::commit_scope_t {
+  commit_scope_t();
+  ~commit_scope_t();
+  void commit();
+  size_t m_outer_begin;
+};
 
 struct trade_v1::Private::transaction_base_t {
   ~transaction_base_t();
   transaction_base_t();
+  bool contend();
   clock_t m_start;
   access_base_t *m_accesses;
   uint8_t *m_alloc;
   uint8_t *m_limit;
+  chunk_t *m_chunk;
+  bool m_written;
+  bool m_irrevocable;
+  bool m_snapshot;
+  bool m_encounter;
+  contention_policy m_policy;
+  uint32_t m_n_aborts;
+  uint64_t m_ticket;
+  molecular::backoff m_backoff;
+  size_t m_n_flat;
+  access_base_t *m_flat[n_flat];
+  alternative_t *m_alternative;
+  undo_base_t *m_undo;
+  locked_t *m_locked;
+  uint32_t m_n_alternatives;
+#if TRADE_V1_ABORT_LONGJMP
+  std::jmp_buf m_restart;
+#endif
 };
 
 struct trade_v1::Private::transaction_heap_t : transaction_base_t {
   transaction_heap_t(heap initial_size);
   void start();
-  std::unique_ptr<uint8_t[]> m_block;
+  size_t m_initial_size;
+};
+
+struct trade_v1::Private::transaction_snapshot_t : transaction_heap_t {
+  transaction_snapshot_t(snapshot_t);
+};
+
+struct trade_v1::Private::transaction_encounter_t : transaction_heap_t {
+  transaction_encounter_t(encounter_locking_t);
+};
+
+struct trade_v1::Private::transaction_irrevocable_t : transaction_base_t {
+  transaction_irrevocable_t(irrevocable_t);
+  void start();
 };
 
 template <size_t Bytes>
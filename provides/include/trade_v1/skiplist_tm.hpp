@@ -0,0 +1,278 @@
+#pragma once
+
+#include "trade_v1/trade.hpp"
+
+#include "dumpster_v1/ranqd1.hpp"
+#include "polyfill_v1/memory.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace trade_v1 {
+
+/// A transactional ordered map implemented as a skip list.  Operations called
+/// outside of a transaction run as transactions of their own and operations
+/// called inside `atomically` compose with the rest of the transaction.
+///
+/// Nodes have randomized tower heights with an expected number of `4/3` links
+/// per node.  A lookup reads the links on the search path, an expected `O(log
+/// n)` atoms, and an insert or erase additionally writes one link per level of
+/// the tower of the node.  `pop_min` only accesses the links at the head of the
+/// list.
+template <class Key, class Value, class Compare = std::less<Key>>
+class skiplist_tm {
+  struct node_t;
+
+  using node_ptr = std::shared_ptr<node_t>;
+
+  struct node_t {
+    std::unique_ptr<atom<node_ptr>[]> m_next;
+    size_t m_height;
+    Key m_key;
+    Value m_value;
+
+    template <class ForwardableValue>
+    node_t(size_t height, const Key &key, ForwardableValue &&value)
+        : m_next(new atom<node_ptr>[height]),
+          m_height(height),
+          m_key(key),
+          m_value(std::forward<ForwardableValue>(value)) {}
+  };
+
+  static constexpr size_t max_height = 16;
+
+  std::unique_ptr<atom<node_ptr>[]> m_head;
+
+  // Number of levels that may contain nodes.  Only grows.  Searches start from
+  // this level, which avoids reading unused levels of the head.
+  std::atomic<size_t> m_top;
+
+  Compare m_less;
+
+  static size_t random_height();
+
+  // Stores the link leading to the first node not less than the key on each
+  // level below `m_top` to `preds` and the node containing the link to
+  // `owners`, which keeps the link alive.
+  void search(const Key &key, atom<node_ptr> **preds, node_ptr *owners) const;
+
+  bool equal(const Key &lhs, const Key &rhs) const;
+
+public:
+  using key_type = Key;
+  using mapped_type = Value;
+
+  skiplist_tm();
+
+  ~skiplist_tm();
+
+  skiplist_tm(const skiplist_tm &) = delete;
+  skiplist_tm &operator=(const skiplist_tm &) = delete;
+
+  /// Returns whether the map has no elements.
+  bool empty() const;
+
+  /// Returns the value of the key or `std::nullopt` if the key is not present.
+  std::optional<Value> find(const Key &key) const;
+
+  /// Returns the first element whose key is not less than the given key or
+  /// `std::nullopt` if there is no such element.
+  std::optional<std::pair<Key, Value>> lower_bound(const Key &key) const;
+
+  /// Calls `fn(key, value)` on elements in order starting from the first
+  /// element whose key is not less than the given key until `fn` returns false
+  /// or there are no more elements.  The elements visited are added to the
+  /// read set of the transaction.  Outside of a transaction the scan runs as a
+  /// readonly transaction and `fn` may be called again on elements after a
+  /// conflict.
+  template <class Function> void scan(const Key &from, Function &&fn) const;
+
+  /// Inserts the key with the given value unless the key is already present.
+  /// Returns whether the key was inserted.
+  template <class ForwardableValue>
+  bool insert(const Key &key, ForwardableValue &&value);
+
+  /// Erases the key.  Returns whether the key was present.
+  bool erase(const Key &key);
+
+  /// Removes and returns the element with the least key or returns
+  /// `std::nullopt` if the map is empty.
+  std::optional<std::pair<Key, Value>> try_pop_min();
+
+  /// Removes and returns the element with the least key.  Blocks with `retry`
+  /// while the map is empty.
+  std::pair<Key, Value> pop_min();
+};
+
+template <class Key, class Value, class Compare>
+size_t skiplist_tm<Key, Value, Compare>::random_height() {
+  thread_local uint32_t s_seed =
+      static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&s_seed));
+  // The high bits of `ranqd1` are the most random.
+  auto bits = s_seed = dumpster::ranqd1(s_seed);
+  size_t height = 1;
+  while (height < max_height && !(bits >> 30)) {
+    height += 1;
+    bits <<= 2;
+  }
+  return height;
+}
+
+template <class Key, class Value, class Compare>
+void skiplist_tm<Key, Value, Compare>::search(const Key &key,
+                                              atom<node_ptr> **preds,
+                                              node_ptr *owners) const {
+  auto links = m_head.get();
+  node_ptr owner;
+  for (auto level = m_top.load(std::memory_order_acquire); level--;) {
+    while (true) {
+      node_ptr next = links[level];
+      if (!next || !m_less(next->m_key, key))
+        break;
+      links = next->m_next.get();
+      owner = std::move(next);
+    }
+    preds[level] = &links[level];
+    owners[level] = owner;
+  }
+}
+
+template <class Key, class Value, class Compare>
+bool skiplist_tm<Key, Value, Compare>::equal(const Key &lhs,
+                                             const Key &rhs) const {
+  return !m_less(lhs, rhs) && !m_less(rhs, lhs);
+}
+
+template <class Key, class Value, class Compare>
+skiplist_tm<Key, Value, Compare>::skiplist_tm()
+    : m_head(new atom<node_ptr>[max_height]), m_top(1) {}
+
+template <class Key, class Value, class Compare>
+skiplist_tm<Key, Value, Compare>::~skiplist_tm() {
+  // Releases nodes front to back to avoid recursive destruction of the list.
+  std::vector<node_ptr> nodes;
+  for (auto node = m_head[0].unsafe_load(); node;
+       node = node->m_next[0].unsafe_load())
+    nodes.push_back(node);
+  m_head.reset();
+  for (auto &node : nodes)
+    node.reset();
+}
+
+template <class Key, class Value, class Compare>
+bool skiplist_tm<Key, Value, Compare>::empty() const {
+  return atomically(assume_readonly, [&]() { return !m_head[0].load(); });
+}
+
+template <class Key, class Value, class Compare>
+std::optional<Value>
+skiplist_tm<Key, Value, Compare>::find(const Key &key) const {
+  return atomically(assume_readonly, [&]() -> std::optional<Value> {
+    atom<node_ptr> *preds[max_height];
+    node_ptr owners[max_height];
+    search(key, preds, owners);
+    node_ptr node = *preds[0];
+    if (node && equal(node->m_key, key))
+      return node->m_value;
+    return std::nullopt;
+  });
+}
+
+template <class Key, class Value, class Compare>
+std::optional<std::pair<Key, Value>>
+skiplist_tm<Key, Value, Compare>::lower_bound(const Key &key) const {
+  return atomically(
+      assume_readonly, [&]() -> std::optional<std::pair<Key, Value>> {
+        atom<node_ptr> *preds[max_height];
+        node_ptr owners[max_height];
+        search(key, preds, owners);
+        if (node_ptr node = *preds[0])
+          return std::make_pair(node->m_key, node->m_value);
+        return std::nullopt;
+      });
+}
+
+template <class Key, class Value, class Compare>
+template <class Function>
+void skiplist_tm<Key, Value, Compare>::scan(const Key &from,
+                                            Function &&fn) const {
+  atomically(assume_readonly, [&]() {
+    atom<node_ptr> *preds[max_height];
+    node_ptr owners[max_height];
+    search(from, preds, owners);
+    for (node_ptr node = *preds[0]; node && fn(node->m_key, node->m_value);
+         node = node->m_next[0])
+      ;
+  });
+}
+
+template <class Key, class Value, class Compare>
+template <class ForwardableValue>
+bool skiplist_tm<Key, Value, Compare>::insert(const Key &key,
+                                              ForwardableValue &&value) {
+  auto height = random_height();
+  auto top = m_top.load(std::memory_order_relaxed);
+  while (top < height &&
+         !m_top.compare_exchange_weak(top, height, std::memory_order_release))
+    ;
+  auto node = std::make_shared<node_t>(
+      height, key, std::forward<ForwardableValue>(value));
+  return atomically([&]() {
+    atom<node_ptr> *preds[max_height];
+    node_ptr owners[max_height];
+    search(key, preds, owners);
+    node_ptr next = *preds[0];
+    if (next && !m_less(key, next->m_key))
+      return false;
+    for (size_t level = 0; level < height; ++level) {
+      node->m_next[level] = preds[level]->load();
+      *preds[level] = node;
+    }
+    return true;
+  });
+}
+
+template <class Key, class Value, class Compare>
+bool skiplist_tm<Key, Value, Compare>::erase(const Key &key) {
+  return atomically([&]() {
+    atom<node_ptr> *preds[max_height];
+    node_ptr owners[max_height];
+    search(key, preds, owners);
+    node_ptr node = *preds[0];
+    if (!node || !equal(node->m_key, key))
+      return false;
+    // The node is the first node not less than the key on each of its levels.
+    for (size_t level = 0; level < node->m_height; ++level)
+      *preds[level] = node->m_next[level].load();
+    return true;
+  });
+}
+
+template <class Key, class Value, class Compare>
+std::optional<std::pair<Key, Value>>
+skiplist_tm<Key, Value, Compare>::try_pop_min() {
+  return atomically([&]() -> std::optional<std::pair<Key, Value>> {
+    node_ptr node = m_head[0];
+    if (!node)
+      return std::nullopt;
+    for (size_t level = 0; level < node->m_height; ++level)
+      m_head[level] = node->m_next[level].load();
+    return std::make_pair(node->m_key, node->m_value);
+  });
+}
+
+template <class Key, class Value, class Compare>
+std::pair<Key, Value> skiplist_tm<Key, Value, Compare>::pop_min() {
+  return atomically([&]() {
+    if (auto min = try_pop_min())
+      return std::move(*min);
+    retry();
+  });
+}
+
+} // namespace trade_v1
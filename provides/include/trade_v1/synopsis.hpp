@@ -5,8 +5,51 @@
 /// A transactional locking library.
 namespace trade_v1 {
 
-/// Type of transactional variables or atoms.
-template <class Value> struct atom : Private::atom_t<Value> {
+/// Specifies that an atom is protected by a lock in a global hash table of
+/// locks.  This is the default for `atom`.
+struct hashed_lock {};
+
+/// Specifies that an atom is protected by a lock stored inside the atom.  Such
+/// an atom is larger than `std::atomic<Value>`, but accessing it does not
+/// involve a hash computation or an additional cache miss to access the lock
+/// and it never conflicts with unrelated atoms.
+struct inline_lock {};
+
+/// A lock shared by a group of atoms.  An atom of type `atom<Value,
+/// lock_group>` is constructed with a reference to a lock group and is protected
+/// by the lock of the group.  Atoms that are always accessed together, such as
+/// the fields of a record, can be put into a group so that a transaction only
+/// needs a single lock acquisition on commit for all of them.  A transaction
+/// blocked in `retry` is still only woken by writes to the atoms it read.  A
+/// lock group must outlive its atoms.
+class lock_group : Private::lock_t {
+  friend class Private;
+
+public:
+  /// Constructs a new lock group.
+  lock_group();
+
+  /// Lock groups are not CopyConstructible.
+  lock_group(const lock_group &) = delete;
+
+  /// Lock groups are not CopyAssignable.
+  lock_group &operator=(const lock_group &) = delete;
+};
+
+/// Specifies that an atom is protected by the given kind of lock and retains
+/// its `Depth` most recent previous values tagged with the versions during
+/// which they were current.  A `snapshot` transaction reads such an atom as of
+/// the start of the transaction instead of aborting when the atom has been
+/// written since.  Commits to a versioned atom additionally copy the previous
+/// value.  With `hashed_lock` or `lock_group` the retained versions are tagged
+/// conservatively using the version of the shared lock.
+template <class Lock = hashed_lock, size_t Depth = 4> struct versioned {
+  static_assert(0 < Depth);
+};
+
+/// Type of transactional variables or atoms.  `atom<Value>` is equivalent to
+/// `atom<Value, hashed_lock>`.
+template <class Value, class Lock> struct atom : Private::atom_t<Value, Lock> {
   /// Type of contained value.
   using value_type = Value;
 
@@ -16,6 +59,14 @@ template <class Value> struct atom : Private::atom_t<Value> {
   /// Constructs an atom initialized with the given value.
   atom(const Value &value);
 
+  /// Constructs an atom protected by the given lock group and initialized
+  /// with default constructed value.
+  explicit atom(lock_group &group);
+
+  /// Constructs an atom protected by the given lock group and initialized
+  /// with the given value.
+  atom(lock_group &group, const Value &value);
+
   /// Atoms are not CopyConstructible.
   atom(const atom &) = delete;
 
@@ -46,8 +97,27 @@ template <class Value> struct atom : Private::atom_t<Value> {
   /// `atom.store(atom.load())`, but accesses the transaction log only once.
   Value &ref();
 
-  // Atoms are no larger than atomic values.
-  static_assert(sizeof(Private::atom_t<Value>) <= sizeof(std::atomic<Value>));
+  /// Loads the given member of the current value of the atom within a
+  /// transaction.  Unlike `load().*member`, only the member is copied when the
+  /// value is not stored atomically.
+  template <class Field, class Class> Field load(Field Class::*member) const;
+
+  /// Stores the given value to the given member of the value of the atom within
+  /// a transaction.  When the value is not stored atomically, only the members
+  /// written are logged and written back on commit, and storing to a member
+  /// does not read the atom.
+  template <class Field, class Class, class Forwardable>
+  void store(Field Class::*member, Forwardable &&value);
+
+  /// Returns a mutable reference to the given member of the current value of
+  /// the atom within a transaction.  Like `store(member, value)`, only the
+  /// member is logged when the value is not stored atomically.
+  template <class Field, class Class> Field &ref(Field Class::*member);
+
+  // Atoms with hashed locks are no larger than atomic values.
+  static_assert(!std::is_same_v<Lock, hashed_lock> ||
+                sizeof(Private::atom_t<Value, Lock>) <=
+                    sizeof(std::atomic<Value>));
 };
 
 /// Invokes the given action atomically with respect to other transactions.  Any
@@ -57,7 +127,9 @@ template <class Action>
 std::invoke_result_t<Action> atomically(Action &&action);
 
 /// Specifies heap allocation and initial heap size for transaction log to
-/// `atomically`.
+/// `atomically`.  The log is allocated from chunks kept per thread and reused
+/// by later transactions of the thread.  A log that outgrows its chunk
+/// continues in the next chunk without restarting the transaction.
 enum heap : size_t {
   /// Specifies that the transaction is to be assumed read-only.  Read-only
   /// transactions can be performed more efficiently, because they do not
@@ -70,8 +142,9 @@ enum heap : size_t {
 /// Type for specifying stack allocation size configuration to `atomically`.
 template <size_t fixed_size> struct stack_t {};
 
-/// Specifies stack allocation and fixed maximum size of transaction log to
-/// `atomically`.
+/// Specifies stack allocation and size of transaction log to `atomically`.  A
+/// log that does not fit on the stack continues in the chunks used for `heap`
+/// allocation without restarting the transaction.
 template <size_t fixed_size>
 [[maybe_unused]] constexpr stack_t<fixed_size> stack = {};
 
@@ -81,8 +154,263 @@ template <size_t fixed_size>
 template <class Config, class Action>
 std::invoke_result_t<Action> atomically(Config config, Action &&action);
 
+/// Policies for handling conflicts between transactions.
+enum class contention_policy {
+  /// An aborted transaction is restarted immediately and a commit that finds a
+  /// lock held by another transaction aborts immediately.  This is the default.
+  immediate,
+
+  /// An aborted transaction waits for an exponentially growing period of time
+  /// before restarting.
+  backoff,
+
+  /// A commit that finds a lock held by another transaction spins waiting for
+  /// the lock for a bounded period that grows with the number of times the
+  /// transaction has already been aborted.  This does not guarantee that a
+  /// transaction that has been aborted many times wins a conflict, which is
+  /// what `priority` is for.
+  scaled_spin,
+
+  /// A commit that finds a lock held by another transaction waits for the lock
+  /// for a short bounded period before aborting.
+  spin,
+
+  /// Transactions are ordered by age, taken as the order of their first
+  /// aborts.  A transaction that has been aborted a few times publishes itself
+  /// as the oldest transaction unless an older one is already published.
+  /// Younger transactions with this policy wait before acquiring locks to
+  /// commit while an older transaction is published, so the oldest
+  /// transaction commits even against a stream of short writers.  The oldest
+  /// transaction withdraws while it is blocked in `retry`.
+  priority
+};
+
+/// Type for specifying snapshot transactions to `atomically`.
+struct snapshot_t {};
+
+/// Specifies that the transaction is to be assumed read-only and to read atoms
+/// with `versioned` locks as they were at the start of the transaction.  Such
+/// reads only abort when the atom has been written more than `Depth` times
+/// since the start of the transaction, so long read-only transactions complete
+/// under concurrent writes.  Other atoms are read as in `assume_readonly`
+/// transactions.  Any write access during the transaction will cause the
+/// transaction to restart as an ordinary transaction in heap allocation mode.
+[[maybe_unused]] constexpr snapshot_t snapshot = {};
+
+/// Type for specifying transactions that lock on encounter to `atomically`.
+struct encounter_locking_t {};
+
+/// Specifies that the transaction is to acquire the lock of each atom it writes
+/// on the first write instead of on commit and to use heap allocation for the
+/// log.  A write that finds the lock held by another transaction, or finds the
+/// atom written since the transaction started, aborts the transaction
+/// immediately rather than after the rest of the action has been run, which
+/// reduces wasted work in write-heavy transactions on contended atoms.  Locks
+/// are held until commit, so other transactions reading the written atoms
+/// abort in the meantime.  Locks acquired within an alternative of `or_else`
+/// that calls `retry` are released with the undone writes, and all locks are
+/// released before `retry` blocks.  Adds to counters are performed as ordinary
+/// writes.
+[[maybe_unused]] constexpr encounter_locking_t encounter_locking = {};
+
+/// Type for specifying irrevocable transactions to `atomically`.
+struct irrevocable_t {};
+
+/// Specifies that the transaction is to be run irrevocably.  Only one
+/// irrevocable transaction runs at a time.  It acquires the lock of each atom
+/// on first access and never aborts due to conflicts or running out of log
+/// space, which means that the action is run exactly once unless it calls
+/// `retry`.  Other transactions accessing the same atoms abort until the
+/// irrevocable transaction commits.  Writes are still made to the log and
+/// written back on commit, because `retry`, `or_else`, and exceptions must be
+/// able to discard them, but reads are not validated on commit.
+[[maybe_unused]] constexpr irrevocable_t irrevocable = {};
+
+/// Selects the number of aborts after which a transaction is restarted as an
+/// irrevocable transaction.  Aborts due to `retry` are not counted.  The
+/// default, `0`, disables escalation.  Must only be called when no transactions
+/// are running.
+void set_escalation_threshold(uint32_t n_aborts);
+
+/// Invokes the given action atomically with respect to other transactions
+/// using the given contention policy instead of the default policy.
+template <class Config, class Action>
+std::invoke_result_t<Action>
+atomically(Config config, contention_policy policy, Action &&action);
+
+/// Selects the default contention policy of transactions.  Must only be called
+/// when no transactions are running.
+void set_contention_policy(contention_policy policy);
+
 /// Aborts the current transaction, possibly blocks waiting for changes to any
 /// atoms read during the transaction, and then restarts the transaction.
 [[noreturn]] void retry();
 
+/// Invokes `first` and, if it calls `retry`, undoes its writes and invokes
+/// `second` instead as part of the same transaction.  Atoms read by `first` stay
+/// in the transaction, so a transaction in which `second` also calls `retry`
+/// blocks waiting for changes to atoms read by either alternative.  Both
+/// alternatives must return the same type.  Called outside of a transaction,
+/// `or_else` runs in a new transaction of its own.
+template <class First, class Second>
+std::invoke_result_t<First> or_else(First &&first, Second &&second);
+
+/// Calls `action(context)` after the outermost transaction has committed, or
+/// right away when called outside of transactions.  Actions registered by an
+/// attempt that is aborted, or by an alternative of `or_else` that is undone,
+/// are dropped.  Registering the action last registered again, with the same
+/// context, has no effect.  Meant for side-effects, such as growing a
+/// container, that must not be part of the transaction itself.
+void after_commit(void (*action)(void *context), void *context);
+
+/// Returns the index of the lock in the global lock table that protects the
+/// given atom.  Distinct atoms with equal indices share a lock, which may cause
+/// false conflicts between transactions.  Intended for diagnostics.
+template <class Value> size_t lock_index_of(const atom<Value> &atom);
+
+/// Schemes for advancing the global version clock on commit.
+enum class clock_scheme {
+  /// Every writing commit increments the clock.  This is the default and
+  /// corresponds to GV1 of TL2.
+  increment,
+
+  /// A writing commit attempts to increment the clock once and, if the attempt
+  /// fails, uses the clock value installed by a concurrent commit.  This
+  /// corresponds to GV4 of TL2.
+  pass_on_failure,
+
+  /// Writing commits only read the clock and the clock is advanced by
+  /// transactions that abort due to seeing a newer version.  This avoids
+  /// writing to the clock on commit at the cost of additional aborts.  This
+  /// corresponds to GV5 of TL2.
+  advance_on_abort
+};
+
+/// Selects the scheme for advancing the global version clock.  Must only be
+/// called when no transactions are running.
+void set_clock_scheme(clock_scheme scheme);
+
+/// Reasons for aborting a transaction counted in `stats`.
+enum class abort_reason {
+  /// A read found an atom with a version newer than the start of the
+  /// transaction and the start could not be moved past it, because an atom
+  /// read before had also changed or the transaction keeps no log.
+  too_new,
+
+  /// An atom was changed by a commit while it was being read.
+  changed,
+
+  /// A commit, or a write locking on encounter, found the lock of a written
+  /// atom held by another transaction.
+  locked,
+
+  /// A commit found that an atom read by the transaction had been changed, or a
+  /// write locking on encounter found the atom changed since the start.
+  invalidated,
+
+  /// A transaction assumed to be read-only attempted to write and was restarted
+  /// in heap allocation mode.
+  readonly_escalation,
+
+  /// The transaction called `retry`.
+  retry,
+
+  /// The action threw an exception, which was propagated out of `atomically`.
+  user_exception
+};
+
+/// Number of `abort_reason` values.
+constexpr size_t n_abort_reasons = 7;
+
+/// Number of buckets in `stats::n_attempts_by_size`.
+constexpr size_t n_size_buckets = 16;
+
+/// Counts of transaction events.
+struct stats {
+  /// Number of times transactions were started or restarted.
+  uint64_t n_starts;
+
+  /// Number of committed transactions.
+  uint64_t n_commits;
+
+  /// Number of aborts indexed by `abort_reason`.
+  uint64_t n_aborts[n_abort_reasons];
+
+  /// Number of times a transaction blocked in `retry`.
+  uint64_t n_parks;
+
+  /// Number of wakeups of transactions blocked in `retry`.
+  uint64_t n_wakeups;
+
+  /// Number of times a transaction woken from `retry` blocked again in `retry`
+  /// before committing.
+  uint64_t n_spurious_wakeups;
+
+  /// Number of times a transaction read an atom written since it started and
+  /// moved its start time forward instead of aborting.
+  uint64_t n_extensions;
+
+  /// Number of locks acquired for writing atoms, whether on commit or on
+  /// encounter, including acquisitions by attempts that were later aborted.
+  uint64_t n_lock_acquisitions;
+
+  /// Number of bytes of transaction log used including padding.
+  uint64_t n_log_bytes;
+
+  /// Number of distinct atoms accessed summed over all transaction attempts.
+  uint64_t n_accesses;
+
+  /// Number of transaction attempts by number of distinct atoms accessed.
+  /// Bucket `0` counts attempts that accessed no atoms through a log and bucket
+  /// `i` counts attempts that accessed from `2^(i-1)` to `2^i - 1` atoms.  The
+  /// last bucket also counts all larger attempts.
+  uint64_t n_attempts_by_size[n_size_buckets];
+};
+
+/// Returns the sum of the counts of all threads since the last `reset_stats`.
+/// Counts are only collected when Trade.C++ is built with `TRADE_V1_STATS`
+/// defined as `1`.  Otherwise all counts are zero.
+stats get_stats();
+
+/// Resets the counts returned by `get_stats` to zero.
+void reset_stats();
+
+/// Conflicts of an atom recorded by the conflict profiler.
+struct hot_spot {
+  /// Address of the atom.
+  const void *atom;
+
+  /// Address of the lock protecting the atom.
+  const void *lock;
+
+  /// Index of the lock in the global lock table as returned by `lock_index_of`
+  /// or `-1` for inline locks and lock groups.
+  ptrdiff_t lock_index;
+
+  /// Number of conflicts on the atom attributed to the atom itself having been
+  /// written by another transaction.
+  uint64_t n_true_conflicts;
+
+  /// Number of conflicts on the atom attributed to another atom protected by
+  /// the same lock having been written by another transaction.
+  uint64_t n_collisions;
+};
+
+/// Returns the atoms that have caused transactions to abort since the last
+/// `reset_hot_spots` in descending order of the total number of conflicts.  A
+/// conflict is attributed to the atom itself if the atom has been written by a
+/// commit since the aborted transaction started and to a collision otherwise.
+/// Writes are only seen once committed, so a conflict with a commit still in
+/// progress is attributed to a collision.  Conflicts are only recorded
+/// when Trade.C++ is built with `TRADE_V1_PROFILE` defined as `1`.  Otherwise
+/// the result is empty.
+std::vector<hot_spot> get_hot_spots();
+
+/// Writes a heat map of the locks and atoms with the most conflicts, at most
+/// `max_rows` of each, to the given file.
+void dump_hot_spots(FILE *file = stderr, size_t max_rows = 20);
+
+/// Forgets all recorded conflicts.
+void reset_hot_spots();
+
 } // namespace trade_v1
@@ -5,44 +5,86 @@
 #include "trade_v1/private/private-methods.hpp"
 #include "trade_v1/private/run-methods.hpp"
 
-template <class Value> trade_v1::atom<Value>::atom() {}
+template <class Value, class Lock> trade_v1::atom<Value, Lock>::atom() {}
 
-template <class Value>
-trade_v1::atom<Value>::atom(const Value &value)
-    : Private::atom_t<Value>(value) {}
+template <class Value, class Lock>
+trade_v1::atom<Value, Lock>::atom(const Value &value)
+    : Private::atom_t<Value, Lock>(value) {}
+
+template <class Value, class Lock>
+trade_v1::atom<Value, Lock>::atom(lock_group &group)
+    : Private::atom_t<Value, Lock>(group) {}
 
-template <class Value> trade_v1::atom<Value>::operator Value() const {
+template <class Value, class Lock>
+trade_v1::atom<Value, Lock>::atom(lock_group &group, const Value &value)
+    : Private::atom_t<Value, Lock>(group, value) {}
+
+template <class Value, class Lock>
+trade_v1::atom<Value, Lock>::operator Value() const {
   return Private::load(*this);
 }
 
-template <class Value> Value trade_v1::atom<Value>::load() const {
+template <class Value, class Lock>
+Value trade_v1::atom<Value, Lock>::load() const {
   return Private::load(*this);
 }
 
-template <class Value> Value trade_v1::atom<Value>::unsafe_load() const {
+template <class Value, class Lock>
+Value trade_v1::atom<Value, Lock>::unsafe_load() const {
   return Private::unsafe_load(*this);
 }
 
-template <class Value> Value &trade_v1::atom<Value>::ref() {
+template <class Value, class Lock> Value &trade_v1::atom<Value, Lock>::ref() {
   return Private::ref(*this);
 }
 
-template <class Value>
+template <class Value, class Lock>
+template <class Field, class Class>
+Field trade_v1::atom<Value, Lock>::load(Field Class::*member) const {
+  return Private::load(*this, static_cast<Field Value::*>(member));
+}
+
+template <class Value, class Lock>
+template <class Field, class Class, class Forwardable>
+void trade_v1::atom<Value, Lock>::store(Field Class::*member,
+                                        Forwardable &&value) {
+  Private::store(*this,
+                 static_cast<Field Value::*>(member),
+                 std::forward<Forwardable>(value));
+}
+
+template <class Value, class Lock>
+template <class Field, class Class>
+Field &trade_v1::atom<Value, Lock>::ref(Field Class::*member) {
+  return Private::ref(*this, static_cast<Field Value::*>(member));
+}
+
+template <class Value, class Lock>
 template <class Forwardable>
-Value &trade_v1::atom<Value>::operator=(Forwardable &&value) {
+Value &trade_v1::atom<Value, Lock>::operator=(Forwardable &&value) {
   return Private::store(*this, std::forward<Forwardable>(value));
 }
 
-template <class Value>
+template <class Value, class Lock>
 template <class Forwardable>
-Value &trade_v1::atom<Value>::store(Forwardable &&value) {
+Value &trade_v1::atom<Value, Lock>::store(Forwardable &&value) {
   return Private::store(*this, std::forward<Forwardable>(value));
 }
 
+inline trade_v1::lock_group::lock_group() : Private::lock_t{{0}, nullptr} {}
+
+template <class Config, class Action>
+std::invoke_result_t<Action> trade_v1::atomically(Config config,
+                                                  Action &&action) {
+  return Private::atomically(
+      config, Private::s_contention_policy, std::forward<Action>(action));
+}
+
 template <class Config, class Action>
 std::invoke_result_t<Action> trade_v1::atomically(Config config,
+                                                  contention_policy policy,
                                                   Action &&action) {
-  return Private::atomically(config, std::forward<Action>(action));
+  return Private::atomically(config, policy, std::forward<Action>(action));
 }
 
 template <class Action>
@@ -51,3 +93,26 @@ std::invoke_result_t<Action> trade_v1::atomically(Action &&action) {
 }
 
 inline void trade_v1::retry() { Private::retry(Private::s_transaction); }
+
+template <class First, class Second>
+std::invoke_result_t<First> trade_v1::or_else(First &&first, Second &&second) {
+  return Private::or_else(std::forward<First>(first),
+                          std::forward<Second>(second));
+}
+
+template <class Value>
+size_t trade_v1::lock_index_of(const atom<Value> &atom) {
+  return static_cast<size_t>(Private::lock_ix_of(atom));
+}
+
+inline void trade_v1::set_clock_scheme(clock_scheme scheme) {
+  Private::s_clock_scheme = scheme;
+}
+
+inline void trade_v1::set_contention_policy(contention_policy policy) {
+  Private::s_contention_policy = policy;
+}
+
+inline void trade_v1::set_escalation_threshold(uint32_t n_aborts) {
+  Private::s_escalation_threshold = n_aborts;
+}
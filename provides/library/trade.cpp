@@ -1,14 +1,38 @@
 #include "trade_v1/trade.hpp"
 
+#include <algorithm>
 #include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
 #include <mutex>
-
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// A transaction blocked in `retry` has a waiter for every atom it read in the
+// list of the lock of the atom.  Waiters are removed from the list, either by
+// their owner or by a committing transaction that wrote the atom, while the
+// lowest bit of the list pointer is set, which blocks pushes.  A committing
+// transaction clears `m_linked` as its last access to each removed waiter.
 struct trade_v1::Private::waiter_t {
   waiter_t *m_next;
-  waiter_t **m_link;
+  const atom_mono_t *m_atom;
+  lock_t *m_lock;
   signal_t *m_signal;
+  std::atomic<bool> m_linked;
+};
+
+// A chunk of log space followed by `m_size` bytes.
+struct trade_v1::Private::chunk_t {
+  chunk_t *m_next;
+  size_t m_size;
 };
 
 trade_v1::Private::lock_t trade_v1::Private::s_locks[n_locks];
@@ -16,88 +40,466 @@ trade_v1::Private::lock_t trade_v1::Private::s_locks[n_locks];
 thread_local trade_v1::Private::transaction_base_t
     *trade_v1::Private::s_transaction;
 
+thread_local size_t trade_v1::Private::s_commit_hooks_begin;
+thread_local size_t trade_v1::Private::s_n_commit_hooks;
+
+thread_local std::atomic<uint64_t> *trade_v1::Private::s_counts;
+
 std::atomic<trade_v1::Private::clock_t> trade_v1::Private::s_clock(0);
 
+trade_v1::clock_scheme trade_v1::Private::s_clock_scheme =
+    trade_v1::clock_scheme::increment;
+
+trade_v1::contention_policy trade_v1::Private::s_contention_policy =
+    trade_v1::contention_policy::immediate;
+
+uint32_t trade_v1::Private::s_escalation_threshold = 0;
+
+// A signal is a word that is `0` when not signaled, `1` when signaled, and `2`
+// when the waiter is parked.  On Linux the waiter parks on the word with a
+// futex.
 struct trade_v1::Private::signal_t {
-  signal_t() : m_signaled(false) {}
+  signal_t() : m_state(0) {}
+
+  void wait();
+  void notify();
+
+  std::atomic<uint32_t> m_state;
+#ifndef __linux__
   std::mutex m_mutex;
-  std::atomic<bool> m_signaled;
   std::condition_variable m_condition_variable;
+#endif
 };
 
+#ifdef __linux__
+void trade_v1::Private::signal_t::wait() {
+  uint32_t state = 0;
+  if (m_state.compare_exchange_strong(state, 2)) {
+    if constexpr (counting)
+      count(offsetof(stats, n_parks));
+    do
+      syscall(SYS_futex, &m_state, FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0);
+    while (2 == m_state.load());
+  }
+}
+
+void trade_v1::Private::signal_t::notify() {
+  if (2 == m_state.exchange(1))
+    syscall(SYS_futex, &m_state, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
+#else
+void trade_v1::Private::signal_t::wait() {
+  std::unique_lock<std::mutex> guard(m_mutex);
+  if (!m_state.load(std::memory_order_relaxed)) {
+    if constexpr (counting)
+      count(offsetof(stats, n_parks));
+    m_state.store(2, std::memory_order_relaxed);
+    do
+      m_condition_variable.wait(guard);
+    while (2 == m_state.load(std::memory_order_relaxed));
+  }
+}
+
+void trade_v1::Private::signal_t::notify() {
+  {
+    std::unique_lock<std::mutex> guard(m_mutex);
+    m_state.store(1, std::memory_order_relaxed);
+  }
+  m_condition_variable.notify_one();
+}
+#endif
+
 struct trade_v1::Private::Static {
-  static clock_t acquire(lock_t &lock) {
-    molecular::backoff backoff;
-    while (true) {
-      auto u = lock.m_clock.load(std::memory_order_relaxed);
-      if (0 <= static_cast<signed_clock_t>(u))
-        if (lock.m_clock.compare_exchange_weak(
-                u, ~u, std::memory_order_acquire))
-          return u;
-      backoff();
+  static std::mutex s_irrevocable_mutex;
+
+  static constexpr size_t n_counts = sizeof(stats) / sizeof(uint64_t);
+
+  struct thread_counts_t {
+    thread_counts_t() {
+      for (auto &count : m_counts)
+        count.store(0, std::memory_order_relaxed);
+      std::unique_lock<std::mutex> guard(s_counts_mutex);
+      s_thread_counts.push_back(this);
+      s_counts = m_counts;
+    }
+
+    ~thread_counts_t() {
+      std::unique_lock<std::mutex> guard(s_counts_mutex);
+      for (size_t i = 0; i < n_counts; ++i)
+        s_exited_counts[i] += m_counts[i].load(std::memory_order_relaxed);
+      s_thread_counts.erase(
+          std::find(s_thread_counts.begin(), s_thread_counts.end(), this));
+      s_counts = nullptr;
+    }
+
+    std::atomic<uint64_t> m_counts[n_counts];
+  };
+
+  static std::mutex s_counts_mutex;
+  static std::vector<thread_counts_t *> s_thread_counts;
+  static uint64_t s_exited_counts[n_counts];
+  static uint64_t s_reset_counts[n_counts];
+
+  thread_local static uint64_t s_n_accesses_at_start;
+
+  // Whether the thread has been woken from `retry` and not committed since.
+  thread_local static bool s_woken;
+
+  struct commit_hook_t {
+    void (*m_action)(void *context);
+    void *m_context;
+  };
+
+  // The actions registered by `after_commit`, of which only those before
+  // `s_n_commit_hooks` are current.  Entries are reused, so registering only
+  // allocates when more actions are registered than ever before.
+  thread_local static std::vector<commit_hook_t> s_commit_hooks;
+
+  // The waiters of a thread, which are reused by every blocking `retry` and
+  // only grow when more atoms have been read than ever before.
+  thread_local static std::unique_ptr<waiter_t[]> s_waiters;
+  thread_local static size_t s_waiters_size;
+
+  static constexpr size_t min_chunk_size = 4096;
+
+  // The list of log chunks of a thread, which is freed when the thread exits.
+  struct chunks_t {
+    ~chunks_t() {
+      while (auto chunk = m_first) {
+        m_first = chunk->m_next;
+        ::operator delete(chunk);
+      }
     }
+
+    chunk_t *m_first = nullptr;
+  };
+
+  thread_local static chunks_t s_chunks;
+
+  static void sum_counts(uint64_t (&sums)[n_counts]) {
+    for (size_t i = 0; i < n_counts; ++i)
+      sums[i] = s_exited_counts[i];
+    for (auto thread_counts : s_thread_counts)
+      for (size_t i = 0; i < n_counts; ++i)
+        sums[i] += thread_counts->m_counts[i].load(std::memory_order_relaxed);
   }
 
-  static void release(lock_t &lock, clock_t at) {
-    lock.m_clock.store(at, std::memory_order_release);
+  struct conflicts_t {
+    const lock_t *m_lock;
+    uint64_t m_n_true_conflicts;
+    uint64_t m_n_collisions;
+  };
+
+  static std::mutex s_conflicts_mutex;
+  static std::unordered_map<const atom_mono_t *, conflicts_t> s_conflicts;
+
+  struct conflict_t {
+    const atom_mono_t *m_atom;
+    const lock_t *m_lock;
+    bool m_is_true;
+  };
+
+  // Conflicts are buffered per thread and merged into `s_conflicts` when the
+  // buffer is full, when the thread exits, and on report, so that recording a
+  // conflict does not contend on a shared mutex.
+  struct thread_conflicts_t {
+    thread_conflicts_t() {
+      std::unique_lock<std::mutex> guard(s_conflicts_mutex);
+      s_thread_conflicts.push_back(this);
+    }
+
+    ~thread_conflicts_t() {
+      std::unique_lock<std::mutex> guard(s_conflicts_mutex);
+      merge();
+      s_thread_conflicts.erase(std::find(
+          s_thread_conflicts.begin(), s_thread_conflicts.end(), this));
+    }
+
+    // Must be called with `s_conflicts_mutex` held.
+    void merge() {
+      std::unique_lock<std::mutex> guard(m_mutex);
+      for (size_t i = 0; i < m_n; ++i) {
+        auto &conflict = m_buffer[i];
+        auto &conflicts = s_conflicts[conflict.m_atom];
+        conflicts.m_lock = conflict.m_lock;
+        if (conflict.m_is_true)
+          conflicts.m_n_true_conflicts += 1;
+        else
+          conflicts.m_n_collisions += 1;
+      }
+      m_n = 0;
+    }
+
+    static constexpr size_t n_buffer = 256;
+
+    std::mutex m_mutex;
+    size_t m_n = 0;
+    conflict_t m_buffer[n_buffer];
+  };
+
+  static std::vector<thread_conflicts_t *> s_thread_conflicts;
+
+  static ptrdiff_t lock_index_of(const lock_t &lock) {
+    auto offset = reinterpret_cast<uintptr_t>(&lock) -
+                  reinterpret_cast<uintptr_t>(s_locks);
+    return offset < sizeof(s_locks) ? offset / sizeof(lock_t) : -1;
+  }
+
+  struct written_t {
+    std::atomic<const atom_mono_t *> m_atom;
+    std::atomic<clock_t> m_version;
+  };
+
+  static constexpr int n_written_log2 = 16;
+
+  // The version at which an atom was last written, kept in a table hashed by
+  // the address of the atom.  An atom whose slot has been taken by another
+  // atom is taken to have not been written.
+  static written_t &written(const atom_mono_t *atom) {
+    static std::unique_ptr<written_t[]> written(
+        new written_t[size_t(1) << n_written_log2]());
+    auto address = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(atom));
+    return written[(address * UINT64_C(0x9E3779B97F4A7C15)) >>
+                   (64 - n_written_log2)];
+  }
+
+  static void count_attempt_size() {
+    if (auto counts = s_counts) {
+      auto n = counts[offsetof(stats, n_accesses) / sizeof(uint64_t)].load(
+                   std::memory_order_relaxed) -
+               s_n_accesses_at_start;
+      size_t bucket = 0;
+      while (n && bucket < n_size_buckets - 1) {
+        n >>= 1;
+        bucket += 1;
+      }
+      count(offsetof(stats, n_attempts_by_size) + sizeof(uint64_t) * bucket);
+    }
   }
 
+  // Acquires the lock unless it is held or newer than `t`.  A change of just
+  // the waiting bit is not a conflict.
+  static bool try_acquire(lock_t &lock, clock_t t, clock_t &s) {
+    while (!(t < (s & ~waiting_bit)))
+      if (lock.m_clock.compare_exchange_weak(s, ~(s & ~irrevocable_bit)))
+        return true;
+    return false;
+  }
+
+  // Acquires the lock regardless of the version for blind adds, which do not
+  // depend on the previous value.
+  static bool try_acquire_blind(lock_t &lock, clock_t &s) {
+    while (0 <= static_cast<signed_clock_t>(s))
+      if (lock.m_clock.compare_exchange_weak(s, ~s))
+        return true;
+    return false;
+  }
+
+  // Locks are released by read-modify-write, because a waiter may set the
+  // waiting bit while the lock is held.
   static void release(lock_t &lock) {
-    release(lock, ~lock.m_clock.load(std::memory_order_relaxed));
+    lock.m_clock.fetch_xor(~clock_t(0), std::memory_order_release);
   }
 
-  static void *align_to(size_t align_m1, void *ptr) {
-    return reinterpret_cast<void *>((reinterpret_cast<size_t>(ptr) + align_m1) &
-                                    ~align_m1);
+  // Returns the number of backoff rounds the contention policy of the
+  // transaction allows waiting for a lock held by another transaction.
+  static uint32_t n_wait_rounds(transaction_base_t *transaction) {
+    switch (transaction->m_policy) {
+    case contention_policy::spin:
+      return n_spin_rounds;
+    case contention_policy::scaled_spin:
+      return std::min(transaction->m_n_aborts, n_scaled_spin_rounds);
+    default:
+      return 0;
+    }
   }
 
-  static access_base_t *alloc_align(transaction_base_t *transaction,
-                                    size_t align_m1) {
-    return static_cast<access_base_t *>(
-        align_to(align_m1, transaction->m_alloc));
+  static clock_t await_unlocked(transaction_base_t *transaction,
+                                lock_t &lock) {
+    auto s = lock.m_clock.load(std::memory_order_relaxed);
+    if (static_cast<signed_clock_t>(s) < 0 && !transaction->m_irrevocable) {
+      auto n_rounds = n_wait_rounds(transaction);
+      molecular::backoff backoff;
+      while (n_rounds-- &&
+             static_cast<signed_clock_t>(
+                 s = lock.m_clock.load(std::memory_order_relaxed)) < 0)
+        backoff();
+    }
+    return s;
   }
 
-  static bool
-  alloc_limit(transaction_base_t *transaction, void *start, size_t size) {
-    return (transaction->m_alloc = static_cast<uint8_t *>(start) + size) <=
-           transaction->m_limit;
+  static void advance(clock_t s) {
+    s &= ~waiting_bit;
+    if (s_clock_scheme == clock_scheme::advance_on_abort &&
+        0 <= static_cast<signed_clock_t>(s)) {
+      auto c = s_clock.load(std::memory_order_relaxed);
+      while (c < s && !s_clock.compare_exchange_weak(c, s))
+        ;
+    }
   }
 
-  static void wait(clock_t t, signal_t &signal, access_base_t *root) {
-    if (root) {
-      if (root->m_state & READ) {
-        auto &lock = s_locks[root->m_lock_ix];
+  static bool has_waiters(clock_t s) {
+    return (s >> 62 == 3 ? ~s : s) & waiting_bit;
+  }
 
-        auto s = lock.m_clock.load(std::memory_order_relaxed);
-        if (t < s || !lock.m_clock.compare_exchange_strong(
-                         s, ~s, std::memory_order_acquire))
-          return;
+  static bool is_removing(waiter_t *first) {
+    return reinterpret_cast<uintptr_t>(first) & 1;
+  }
 
-        auto first = lock.m_first;
+  static waiter_t *removing(waiter_t *first) {
+    return reinterpret_cast<waiter_t *>(reinterpret_cast<uintptr_t>(first) | 1);
+  }
 
-        waiter_t waiter = {first, &lock.m_first, &signal};
+  // Waits until no waiter is being removed and replaces the list.  Returns the
+  // list before the update.
+  template <class Update>
+  static waiter_t *update_waiters(lock_t &lock, Update &&update) {
+    molecular::backoff backoff;
+    auto first = lock.m_first.load(std::memory_order_relaxed);
+    while (true) {
+      if (is_removing(first)) {
+        backoff();
+        first = lock.m_first.load(std::memory_order_relaxed);
+      } else if (lock.m_first.compare_exchange_weak(first, update(first))) {
+        return first;
+      }
+    }
+  }
 
-        lock.m_first = &waiter;
-        if (first)
-          first->m_link = &waiter.m_next;
+  static void unregister(waiter_t &waiter) {
+    if (!waiter.m_linked.load(std::memory_order_acquire))
+      return;
 
-        release(lock, s);
+    auto &lock = *waiter.m_lock;
+    auto first = update_waiters(lock, removing);
 
-        wait(t, signal, root->m_children[1]);
+    bool removed = true;
+    if (first == &waiter) {
+      first = waiter.m_next;
+    } else {
+      auto prev = first;
+      while (prev && prev->m_next != &waiter)
+        prev = prev->m_next;
+      if (prev)
+        prev->m_next = waiter.m_next;
+      else
+        removed = false;
+    }
 
-        auto u = acquire(lock);
+    lock.m_first.store(first);
 
-        if (auto next = *waiter.m_link = waiter.m_next)
-          next->m_link = waiter.m_link;
+    // A waiter not in the list has been removed by a committing transaction,
+    // which may not be done with it yet.
+    if (!removed) {
+      molecular::backoff backoff;
+      while (waiter.m_linked.load(std::memory_order_acquire))
+        backoff();
+    }
+  }
+
+  static void wait(clock_t t, access_base_t *accesses) {
+    size_t n_reads = 0;
+    for (auto it = accesses; it; it = it->m_children[1])
+      n_reads += it->m_state & READ;
+
+    if (s_waiters_size < n_reads) {
+      s_waiters_size = std::max(n_reads, 2 * s_waiters_size);
+      s_waiters.reset(new waiter_t[s_waiters_size]);
+    }
+    auto waiters = s_waiters.get();
+    signal_t signal;
 
-        release(lock, u);
+    // The waiting bit is set, or seen set, after the waiter is pushed, which
+    // linearizes with the release of the lock by a committing transaction, so
+    // either the waiter sees the lock as newer or the committing transaction
+    // sees the bit.  The bit is only cleared while the list is empty.
+    size_t n_waiters = 0;
+    bool changed = false;
+    for (auto it = accesses; it && !changed; it = it->m_children[1]) {
+      if (!(it->m_state & READ))
+        continue;
+      auto &lock = *it->m_lock;
+
+      auto &waiter = waiters[n_waiters++];
+      waiter.m_atom = it->m_atom;
+      waiter.m_lock = &lock;
+      waiter.m_signal = &signal;
+      waiter.m_linked.store(true, std::memory_order_relaxed);
+      update_waiters(lock, [&](waiter_t *first) {
+        waiter.m_next = first;
+        return &waiter;
+      });
+
+      // A held lock is waited on without spinning.  The bit is set in the
+      // inverted version of a committing transaction, which keeps it when it
+      // releases the lock, or next to the irrevocable bit.
+      auto s = lock.m_clock.load();
+      while (true) {
+        auto inverted = s >> 62 == 3;
+        auto v = inverted ? ~s : s & ~irrevocable_bit;
+        if (t < (v & ~waiting_bit)) {
+          changed = true;
+          break;
+        } else if (v & waiting_bit ||
+                   lock.m_clock.compare_exchange_weak(
+                       s, inverted ? s & ~waiting_bit : s | waiting_bit)) {
+          break;
+        }
+      }
+    }
+
+    if (!changed)
+      signal.wait();
+
+    for (size_t i = 0; i < n_waiters; ++i)
+      unregister(waiters[i]);
+
+    if constexpr (counting)
+      s_woken = !changed;
+  }
+
+  static bool is_written(const atom_mono_t *atom,
+                         access_base_t *first,
+                         access_base_t *last) {
+    for (auto it = first;; it = it->m_children[1])
+      if (it->m_atom == atom)
+        return true;
+      else if (it == last)
+        return false;
+  }
+
+  // Wakes the waiters for the atoms written under the lock from `first` to
+  // `last` and clears the waiting bit if no waiters remain.
+  static void signal(lock_t &lock, access_base_t *first, access_base_t *last) {
+    auto waiter = update_waiters(lock, removing);
+
+    waiter_t *woken = nullptr;
+    for (auto link = &waiter; *link;) {
+      auto it = *link;
+      if (is_written(it->m_atom, first, last)) {
+        *link = it->m_next;
+        it->m_next = woken;
+        woken = it;
       } else {
-        wait(t, signal, root->m_children[1]);
+        link = &it->m_next;
       }
-    } else {
-      std::unique_lock<std::mutex> guard(signal.m_mutex);
-      if (!signal.m_signaled.load(std::memory_order_relaxed))
-        signal.m_condition_variable.wait(guard);
+    }
+
+    if (!waiter) {
+      auto s = lock.m_clock.load();
+      if (0 <= static_cast<signed_clock_t>(s) && s & waiting_bit)
+        lock.m_clock.compare_exchange_strong(s, s & ~waiting_bit);
+    }
+
+    lock.m_first.store(waiter);
+
+    while (woken) {
+      auto next = woken->m_next;
+      woken->m_signal->notify();
+      if constexpr (counting)
+        count(offsetof(stats, n_wakeups));
+      woken->m_linked.store(false, std::memory_order_release);
+      woken = next;
     }
   }
 
@@ -126,6 +528,74 @@ struct trade_v1::Private::Static {
     }
   }
 
+  static bool precedes(const access_base_t *lhs, const access_base_t *rhs) {
+    return lhs->m_lock < rhs->m_lock ||
+           (lhs->m_lock == rhs->m_lock && lhs->m_atom < rhs->m_atom);
+  }
+
+  static void sort_flat(transaction_base_t *transaction) {
+    auto flat = transaction->m_flat;
+    auto n = transaction->m_n_flat;
+    for (size_t i = 1; i < n; ++i) {
+      auto access = flat[i];
+      auto j = i;
+      for (; 0 < j && precedes(access, flat[j - 1]); --j)
+        flat[j] = flat[j - 1];
+      flat[j] = access;
+    }
+  }
+
+  // Visits the nodes of the tree in order without allocating by temporarily
+  // threading each node from the rightmost node of its left subtree.  The tree
+  // is restored by the time the traversal ends.
+  template <class Action>
+  static void in_order(access_base_t *root, Action &&action) {
+    while (root) {
+      auto left = root->m_children[0];
+      if (left) {
+        auto prev = left;
+        while (prev->m_children[1] && prev->m_children[1] != root)
+          prev = prev->m_children[1];
+        if (!prev->m_children[1]) {
+          prev->m_children[1] = root;
+          root = left;
+          continue;
+        }
+        prev->m_children[1] = nullptr;
+      }
+      action(root);
+      root = root->m_children[1];
+    }
+  }
+
+  static access_base_t *tree_of_flat(transaction_base_t *transaction) {
+    sort_flat(transaction);
+
+    access_base_t *root = nullptr;
+    for (size_t i = 0, n = transaction->m_n_flat; i < n; ++i) {
+      auto access = transaction->m_flat[i];
+      access->m_children[0] = root;
+      access->m_children[1] = nullptr;
+      root = access;
+    }
+    transaction->m_n_flat = 0;
+    return root;
+  }
+
+  template <class Action>
+  static void destructively_in_order(transaction_base_t *transaction,
+                                     Action &&action) {
+    if (auto root = transaction->m_accesses) {
+      destructively_in_order(root, action);
+    } else {
+      sort_flat(transaction);
+      auto n = transaction->m_n_flat;
+      transaction->m_n_flat = 0;
+      for (size_t i = 0; i < n; ++i)
+        action(transaction->m_flat[i]);
+    }
+  }
+
   static void append_to(access_base_t **last, access_base_t *node) {
     (*last)->m_children[1] = node;
     *last = node;
@@ -136,13 +606,78 @@ struct trade_v1::Private::Static {
     *tail = &node->m_children[1];
   }
 
+  static void unlock_irrevocably(lock_t &lock) {
+    auto s = lock.m_clock.load(std::memory_order_relaxed);
+    if (is_held_irrevocably(s))
+      lock.m_clock.fetch_and(~irrevocable_bit, std::memory_order_release);
+  }
+
+  // Releases the locks acquired on encounter after `until`.  The versions are
+  // unchanged, because nothing has been written under the locks.
+  static void unlock_encountered(transaction_base_t *transaction,
+                                 locked_t *until) {
+    auto locked = transaction->m_locked;
+    for (; locked != until; locked = locked->m_next)
+      release(*locked->m_lock);
+    transaction->m_locked = locked;
+  }
+
+  // The ticket of the oldest transaction with the `priority` policy that has
+  // been aborted enough times, or zero.
+  static std::atomic<uint64_t> s_oldest_ticket, s_next_ticket;
+
+  // Waits before a transaction with the `priority` policy acquires locks while
+  // an older transaction is published.  The waiting transaction holds no
+  // locks, and the oldest transaction withdraws before blocking in `retry`, so
+  // the oldest transaction never waits for it.
+  static void yield_to_older(transaction_base_t *transaction) {
+    molecular::backoff backoff;
+    while (true) {
+      auto oldest = s_oldest_ticket.load(std::memory_order_acquire);
+      if (!oldest || oldest == transaction->m_ticket ||
+          (transaction->m_ticket && transaction->m_ticket < oldest))
+        return;
+      backoff();
+    }
+  }
+
+  // Waits for a bounded period for the lock to be released before an abort
+  // due to the lock being held.  A transaction locking on encounter that
+  // restarts right away would likely find the lock still held, which can
+  // livelock against a lock holder that has been preempted.  Other
+  // transactions only wait as long as their contention policy allows.  Locks
+  // acquired on encounter are released first, so the wait cannot deadlock.
+  static void await_release(transaction_base_t *transaction, lock_t &lock) {
+    auto n_rounds = transaction->m_encounter ? n_encounter_rounds
+                                             : n_wait_rounds(transaction);
+    if (!n_rounds)
+      return;
+    unlock_encountered(transaction, nullptr);
+    molecular::backoff backoff;
+    while (n_rounds-- && static_cast<signed_clock_t>(lock.m_clock.load(
+                             std::memory_order_relaxed)) < 0)
+      backoff();
+  }
+
+  static void roll_back(transaction_base_t *transaction,
+                        alternative_t &alternative) {
+    auto undo = transaction->m_undo;
+    for (; undo != alternative.m_undo; undo = undo->m_next)
+      undo->m_undo(undo, true);
+    transaction->m_undo = undo;
+    // Writes of the alternative are undone, so locks acquired on encounter by
+    // the alternative are not needed.  Locks acquired before the alternative
+    // are still needed by the writes made before it.
+    unlock_encountered(transaction, alternative.m_locked);
+    s_n_commit_hooks = alternative.m_n_commit_hooks;
+    transaction->m_written = alternative.m_written;
+    transaction->m_alternative = alternative.m_outer;
+  }
+
   static void unlock_and_destroy(access_base_t *it) {
     while (it) {
-      auto ix = it->m_lock_ix;
-      if (0 <= ix) {
-        auto &lock = s_locks[ix];
-        Static::release(lock);
-      }
+      if (auto lock = it->m_lock)
+        Static::release(*lock);
       it->m_destroy(0, it);
 
       it = it->m_children[1];
@@ -150,26 +685,339 @@ struct trade_v1::Private::Static {
   }
 };
 
+std::mutex trade_v1::Private::Static::s_irrevocable_mutex;
+
+std::atomic<uint64_t> trade_v1::Private::Static::s_oldest_ticket(0);
+std::atomic<uint64_t> trade_v1::Private::Static::s_next_ticket(1);
+
+std::mutex trade_v1::Private::Static::s_counts_mutex;
+std::vector<trade_v1::Private::Static::thread_counts_t *>
+    trade_v1::Private::Static::s_thread_counts;
+uint64_t trade_v1::Private::Static::s_exited_counts[n_counts];
+uint64_t trade_v1::Private::Static::s_reset_counts[n_counts];
+
+thread_local uint64_t trade_v1::Private::Static::s_n_accesses_at_start;
+thread_local bool trade_v1::Private::Static::s_woken;
+thread_local std::vector<trade_v1::Private::Static::commit_hook_t>
+    trade_v1::Private::Static::s_commit_hooks;
+thread_local std::unique_ptr<trade_v1::Private::waiter_t[]>
+    trade_v1::Private::Static::s_waiters;
+thread_local size_t trade_v1::Private::Static::s_waiters_size;
+thread_local trade_v1::Private::Static::chunks_t
+    trade_v1::Private::Static::s_chunks;
+
+std::mutex trade_v1::Private::Static::s_conflicts_mutex;
+std::unordered_map<const trade_v1::Private::atom_mono_t *,
+                   trade_v1::Private::Static::conflicts_t>
+    trade_v1::Private::Static::s_conflicts;
+std::vector<trade_v1::Private::Static::thread_conflicts_t *>
+    trade_v1::Private::Static::s_thread_conflicts;
+
+void trade_v1::Private::count_start() {
+  thread_local Static::thread_counts_t thread_counts;
+  count(offsetof(stats, n_starts));
+  Static::s_n_accesses_at_start =
+      thread_counts.m_counts[offsetof(stats, n_accesses) / sizeof(uint64_t)]
+          .load(std::memory_order_relaxed);
+}
+
+void trade_v1::Private::add_commit_hook(void (*action)(void *context),
+                                        void *context) {
+  auto &hooks = Static::s_commit_hooks;
+  auto n = s_n_commit_hooks;
+  // An action registered repeatedly, such as by every insert into a container,
+  // is only run once.
+  if (s_commit_hooks_begin < n && hooks[n - 1].m_action == action &&
+      hooks[n - 1].m_context == context)
+    return;
+  if (hooks.size() == n)
+    hooks.push_back({action, context});
+  else
+    hooks[n] = {action, context};
+  s_n_commit_hooks = n + 1;
+}
+
+void trade_v1::Private::run_commit_hooks() {
+  // Transactions started by the actions register and run their own actions
+  // after `n`.
+  for (auto i = s_commit_hooks_begin, n = s_n_commit_hooks; i < n; ++i) {
+    auto hook = Static::s_commit_hooks[i];
+    hook.m_action(hook.m_context);
+  }
+}
+
+void trade_v1::after_commit(void (*action)(void *context), void *context) {
+  if (Private::s_transaction)
+    Private::add_commit_hook(action, context);
+  else
+    action(context);
+}
+
+void trade_v1::Private::count_user_exception() {
+  count_abort(abort_reason::user_exception);
+  Static::s_woken = false;
+}
+
+trade_v1::stats trade_v1::get_stats() {
+  uint64_t sums[Private::Static::n_counts];
+  {
+    std::unique_lock<std::mutex> guard(Private::Static::s_counts_mutex);
+    Private::Static::sum_counts(sums);
+    for (size_t i = 0; i < Private::Static::n_counts; ++i)
+      sums[i] -= Private::Static::s_reset_counts[i];
+  }
+  stats result;
+  memcpy(&result, sums, sizeof(result));
+  return result;
+}
+
+void trade_v1::reset_stats() {
+  std::unique_lock<std::mutex> guard(Private::Static::s_counts_mutex);
+  Private::Static::sum_counts(Private::Static::s_reset_counts);
+}
+
+void trade_v1::Private::profile_conflict(const atom_mono_t *atom,
+                                         const lock_t &lock,
+                                         clock_t t) {
+  thread_local Static::thread_conflicts_t conflicts;
+  // Pairs with the release of the lock after the write was recorded.
+  std::atomic_thread_fence(std::memory_order_acquire);
+  auto &written = Static::written(atom);
+  auto version = written.m_version.load(std::memory_order_relaxed);
+  Static::conflict_t conflict = {
+      atom,
+      &lock,
+      atom == written.m_atom.load(std::memory_order_relaxed) &&
+          t < version};
+  {
+    std::unique_lock<std::mutex> guard(conflicts.m_mutex);
+    if (conflicts.m_n < Static::thread_conflicts_t::n_buffer) {
+      conflicts.m_buffer[conflicts.m_n++] = conflict;
+      return;
+    }
+  }
+  std::unique_lock<std::mutex> guard(Static::s_conflicts_mutex);
+  conflicts.merge();
+  std::unique_lock<std::mutex> thread_guard(conflicts.m_mutex);
+  conflicts.m_buffer[conflicts.m_n++] = conflict;
+}
+
+void trade_v1::Private::profile_write(const atom_mono_t *atom, clock_t u) {
+  auto &written = Static::written(atom);
+  written.m_atom.store(atom, std::memory_order_relaxed);
+  written.m_version.store(u, std::memory_order_relaxed);
+}
+
+std::vector<trade_v1::hot_spot> trade_v1::get_hot_spots() {
+  std::vector<hot_spot> result;
+  {
+    std::unique_lock<std::mutex> guard(Private::Static::s_conflicts_mutex);
+    for (auto thread_conflicts : Private::Static::s_thread_conflicts)
+      thread_conflicts->merge();
+    for (auto &[atom, conflicts] : Private::Static::s_conflicts)
+      result.push_back({atom,
+                        conflicts.m_lock,
+                        Private::Static::lock_index_of(*conflicts.m_lock),
+                        conflicts.m_n_true_conflicts,
+                        conflicts.m_n_collisions});
+  }
+  std::sort(result.begin(), result.end(), [](auto &lhs, auto &rhs) {
+    return lhs.n_true_conflicts + lhs.n_collisions >
+           rhs.n_true_conflicts + rhs.n_collisions;
+  });
+  return result;
+}
+
+void trade_v1::dump_hot_spots(FILE *file, size_t max_rows) {
+  auto atoms = get_hot_spots();
+
+  struct lock_conflicts_t {
+    hot_spot m_total;
+    size_t m_n_atoms;
+  };
+
+  std::vector<lock_conflicts_t> locks;
+  {
+    std::unordered_map<const void *, size_t> ix_of_lock;
+    for (auto &atom : atoms) {
+      auto [it, inserted] = ix_of_lock.emplace(atom.lock, locks.size());
+      if (inserted)
+        locks.push_back({{nullptr, atom.lock, atom.lock_index, 0, 0}, 0});
+      auto &lock = locks[it->second];
+      lock.m_total.n_true_conflicts += atom.n_true_conflicts;
+      lock.m_total.n_collisions += atom.n_collisions;
+      lock.m_n_atoms += 1;
+    }
+  }
+  std::stable_sort(locks.begin(), locks.end(), [](auto &lhs, auto &rhs) {
+    return lhs.m_total.n_true_conflicts + lhs.m_total.n_collisions >
+           rhs.m_total.n_true_conflicts + rhs.m_total.n_collisions;
+  });
+
+  fprintf(file,
+          "%-18s %8s %12s %12s %6s\n",
+          "lock",
+          "index",
+          "true",
+          "collisions",
+          "atoms");
+  for (size_t i = 0; i < locks.size() && i < max_rows; ++i)
+    fprintf(file,
+            "%-18p %8td %12llu %12llu %6zu\n",
+            locks[i].m_total.lock,
+            locks[i].m_total.lock_index,
+            static_cast<unsigned long long>(locks[i].m_total.n_true_conflicts),
+            static_cast<unsigned long long>(locks[i].m_total.n_collisions),
+            locks[i].m_n_atoms);
+
+  fprintf(file,
+          "%-18s %8s %12s %12s\n",
+          "atom",
+          "index",
+          "true",
+          "collisions");
+  for (size_t i = 0; i < atoms.size() && i < max_rows; ++i)
+    fprintf(file,
+            "%-18p %8td %12llu %12llu\n",
+            atoms[i].atom,
+            atoms[i].lock_index,
+            static_cast<unsigned long long>(atoms[i].n_true_conflicts),
+            static_cast<unsigned long long>(atoms[i].n_collisions));
+}
+
+void trade_v1::reset_hot_spots() {
+  std::unique_lock<std::mutex> guard(Private::Static::s_conflicts_mutex);
+  for (auto thread_conflicts : Private::Static::s_thread_conflicts) {
+    std::unique_lock<std::mutex> thread_guard(thread_conflicts->m_mutex);
+    thread_conflicts->m_n = 0;
+  }
+  Private::Static::s_conflicts.clear();
+}
+
+trade_v1::Private::access_base_t *
+trade_v1::Private::alloc_chunk(transaction_base_t *transaction,
+                               size_t align_m1,
+                               size_t size) {
+  next_chunk(transaction, size + align_m1);
+  return alloc(transaction, align_m1, size);
+}
+
+void trade_v1::Private::next_chunk(transaction_base_t *transaction,
+                                   size_t size) {
+  auto current = transaction->m_chunk;
+  auto &link = current ? current->m_next : Static::s_chunks.m_first;
+  auto chunk = link;
+  if (!chunk || chunk->m_size < size) {
+    auto chunk_size = current ? current->m_size * 2 : Static::min_chunk_size;
+    if (chunk_size < size)
+      chunk_size = size;
+    chunk = new (::operator new(sizeof(chunk_t) + chunk_size))
+        chunk_t{link, chunk_size};
+    link = chunk;
+  }
+  transaction->m_chunk = chunk;
+  transaction->m_alloc = reinterpret_cast<uint8_t *>(chunk + 1);
+  transaction->m_limit = transaction->m_alloc + chunk->m_size;
+}
+
+size_t trade_v1::Private::thread_index() {
+  static std::atomic<size_t> s_n_threads(0);
+  thread_local size_t s_index = s_n_threads++;
+  return s_index;
+}
+
+void trade_v1::Private::lock_on_encounter(transaction_base_t *transaction,
+                                          access_base_t *access) {
+  auto &lock = *access->m_lock;
+  auto s = Static::await_unlocked(transaction, lock);
+  if (static_cast<signed_clock_t>(s) < 0 && holds(transaction, lock))
+    return;
+  // Only a transaction that holds no locks yet can wait for older ones
+  // without risking a deadlock.
+  if (transaction->m_policy == contention_policy::priority &&
+      !transaction->m_locked)
+    Static::yield_to_older(transaction);
+  auto locked = static_cast<locked_t *>(static_cast<void *>(
+      alloc(transaction, alignof(locked_t) - 1, sizeof(locked_t))));
+  if (!locked)
+    abort_readonly(transaction);
+  if (!Static::try_acquire(lock, transaction->m_start, s)) {
+    if constexpr (profiling)
+      profile_conflict(access->m_atom, lock, transaction->m_start);
+    if (static_cast<signed_clock_t>(s) < 0) {
+      Static::await_release(transaction, lock);
+      abort(transaction, abort_reason::locked);
+    }
+    Static::advance(s);
+    abort(transaction, abort_reason::invalidated);
+  }
+  if constexpr (counting)
+    count(offsetof(stats, n_lock_acquisitions));
+  locked->m_next = transaction->m_locked;
+  locked->m_lock = &lock;
+  transaction->m_locked = locked;
+}
+
+void trade_v1::Private::claim_priority(transaction_base_t *transaction) {
+  if (!transaction->m_ticket)
+    transaction->m_ticket = Static::s_next_ticket.fetch_add(1);
+  auto ticket = transaction->m_ticket;
+  auto oldest = Static::s_oldest_ticket.load(std::memory_order_relaxed);
+  while ((!oldest || ticket < oldest) &&
+         !Static::s_oldest_ticket.compare_exchange_weak(oldest, ticket))
+    ;
+}
+
+void trade_v1::Private::release_priority(transaction_base_t *transaction) {
+  auto ticket = transaction->m_ticket;
+  Static::s_oldest_ticket.compare_exchange_strong(ticket, 0);
+}
+
+void trade_v1::Private::enter_irrevocable(transaction_base_t *transaction) {
+  Static::s_irrevocable_mutex.lock();
+  transaction->m_irrevocable = true;
+}
+
+void trade_v1::Private::leave_irrevocable(transaction_base_t *transaction) {
+  transaction->m_irrevocable = false;
+  Static::s_irrevocable_mutex.unlock();
+}
+
+trade_v1::Private::clock_t trade_v1::Private::lock_irrevocably(lock_t &lock) {
+  molecular::backoff backoff;
+  while (true) {
+    auto s = lock.m_clock.load(std::memory_order_relaxed);
+    if (is_held_irrevocably(s))
+      return s;
+    if (0 <= static_cast<signed_clock_t>(s) &&
+        lock.m_clock.compare_exchange_weak(s, s | irrevocable_bit))
+      return s | irrevocable_bit;
+    backoff();
+  }
+}
+
 trade_v1::Private::access_base_t *
 trade_v1::Private::insert(transaction_base_t *transaction,
                           atom_mono_t *access_atom,
+                          lock_t *access_lock,
                           size_t align_m1,
                           size_t size) {
   auto root = transaction->m_accesses;
 
-  auto access_ix = lock_ix_of(access_atom);
+  if (!root)
+    root = transaction->m_accesses = Static::tree_of_flat(transaction);
 
   if (!root) {
-    auto access = Static::alloc_align(transaction, align_m1);
-    if (Static::alloc_limit(transaction, access, size)) {
+    if (auto access = alloc(transaction, align_m1, size)) {
       access->m_children[0] = nullptr;
       access->m_children[1] = nullptr;
       access->m_atom = access_atom;
       access->m_state = INITIAL;
-      access->m_lock_ix = access_ix;
+      access->m_saved_in = 0;
+      access->m_lock = access_lock;
       return transaction->m_accesses = access;
     } else {
-      throw transaction;
+      abort_readonly(transaction);
     }
   }
 
@@ -180,31 +1028,31 @@ trade_v1::Private::insert(transaction_base_t *transaction,
   access_base_t **side_near[2] = {&side_root[0], &side_root[1]};
 
   while (true) {
-    if (access_ix <= root->m_lock_ix &&
-        (access_ix != root->m_lock_ix || access_atom < root->m_atom)) {
+    if (access_lock <= root->m_lock &&
+        (access_lock != root->m_lock || access_atom < root->m_atom)) {
       auto next = root->m_children[0];
 
       if (!next) {
         *side_near[0] = nullptr;
         *side_near[1] = root->m_children[1];
         root->m_children[1] = side_root[1];
-        auto access = Static::alloc_align(transaction, align_m1);
-        if (Static::alloc_limit(transaction, access, size)) {
+        if (auto access = alloc(transaction, align_m1, size)) {
           access->m_children[0] = side_root[0];
           access->m_children[1] = root;
           access->m_atom = access_atom;
           access->m_state = INITIAL;
-          access->m_lock_ix = access_ix;
+          access->m_saved_in = 0;
+          access->m_lock = access_lock;
           return transaction->m_accesses = access;
         } else {
           root->m_children[0] = side_root[0];
           transaction->m_accesses = root;
-          throw transaction;
+          abort_readonly(transaction);
         }
       }
 
-      if (access_ix <= next->m_lock_ix &&
-          (access_ix != next->m_lock_ix || access_atom < next->m_atom)) {
+      if (access_lock <= next->m_lock &&
+          (access_lock != next->m_lock || access_atom < next->m_atom)) {
         root->m_children[0] = next->m_children[1];
         next->m_children[1] = root;
         root = next;
@@ -213,18 +1061,18 @@ trade_v1::Private::insert(transaction_base_t *transaction,
         if (!next) {
           *side_near[0] = nullptr;
           *side_near[1] = root;
-          auto access = Static::alloc_align(transaction, align_m1);
-          if (Static::alloc_limit(transaction, access, size)) {
+          if (auto access = alloc(transaction, align_m1, size)) {
             access->m_children[0] = side_root[0];
             access->m_children[1] = side_root[1];
             access->m_atom = access_atom;
             access->m_state = INITIAL;
-            access->m_lock_ix = access_ix;
+            access->m_saved_in = 0;
+            access->m_lock = access_lock;
             return transaction->m_accesses = access;
           } else {
             root->m_children[0] = side_root[0];
             transaction->m_accesses = side_root[1];
-            throw transaction;
+            abort_readonly(transaction);
           }
         }
       }
@@ -239,23 +1087,23 @@ trade_v1::Private::insert(transaction_base_t *transaction,
         *side_near[0] = root->m_children[0];
         *side_near[1] = nullptr;
         root->m_children[0] = side_root[0];
-        auto access = Static::alloc_align(transaction, align_m1);
-        if (Static::alloc_limit(transaction, access, size)) {
+        if (auto access = alloc(transaction, align_m1, size)) {
           access->m_children[0] = root;
           access->m_children[1] = side_root[1];
           access->m_atom = access_atom;
           access->m_state = INITIAL;
-          access->m_lock_ix = access_ix;
+          access->m_saved_in = 0;
+          access->m_lock = access_lock;
           return transaction->m_accesses = access;
         } else {
           root->m_children[1] = side_root[1];
           transaction->m_accesses = root;
-          throw transaction;
+          abort_readonly(transaction);
         }
       }
 
-      if (access_ix >= next->m_lock_ix &&
-          (access_ix != next->m_lock_ix || access_atom > next->m_atom)) {
+      if (access_lock >= next->m_lock &&
+          (access_lock != next->m_lock || access_atom > next->m_atom)) {
         root->m_children[1] = next->m_children[0];
         next->m_children[0] = root;
         root = next;
@@ -264,18 +1112,18 @@ trade_v1::Private::insert(transaction_base_t *transaction,
         if (!next) {
           *side_near[0] = root;
           *side_near[1] = nullptr;
-          auto access = Static::alloc_align(transaction, align_m1);
-          if (Static::alloc_limit(transaction, access, size)) {
+          if (auto access = alloc(transaction, align_m1, size)) {
             access->m_children[0] = side_root[0];
             access->m_children[1] = side_root[1];
             access->m_atom = access_atom;
             access->m_state = INITIAL;
-            access->m_lock_ix = access_ix;
+            access->m_saved_in = 0;
+            access->m_lock = access_lock;
             return transaction->m_accesses = access;
           } else {
             root->m_children[1] = side_root[1];
             transaction->m_accesses = side_root[0];
-            throw transaction;
+            abort_readonly(transaction);
           }
         }
       }
@@ -298,72 +1146,269 @@ trade_v1::Private::insert(transaction_base_t *transaction,
   }
 }
 
-void trade_v1::Private::signal(waiter_t *work) {
-  do {
-    auto signal = work->m_signal;
-    if (!signal->m_signaled.load(std::memory_order_relaxed)) {
-      {
-        std::unique_lock<std::mutex> guard(signal->m_mutex);
-        signal->m_signaled.store(true, std::memory_order_relaxed);
-      }
-      signal->m_condition_variable.notify_all();
+void trade_v1::Private::abort_too_new(transaction_base_t *transaction,
+                                      const atom_mono_t *atom,
+                                      const lock_t &lock,
+                                      clock_t s) {
+  if constexpr (profiling)
+    profile_conflict(atom, lock, transaction->m_start);
+  if (static_cast<signed_clock_t>(s) < 0)
+    Static::await_release(transaction, const_cast<lock_t &>(lock));
+  else
+    Static::advance(s);
+  abort(transaction, abort_reason::too_new);
+}
+
+bool trade_v1::Private::extend(transaction_base_t *transaction, clock_t s) {
+  // Transactions without a log have no record of what they have read and a
+  // lock held by another transaction must be waited for anyway.
+  if (!transaction->m_alloc || static_cast<signed_clock_t>(s) < 0)
+    return false;
+
+  // The clock is read before the locks, so that a commit that changes any of
+  // the atoms read so far with a version at or before the new start time is
+  // seen below as holding the lock or as having changed the version.
+  Static::advance(s);
+  auto c = s_clock.load();
+  auto t = transaction->m_start;
+
+  bool unchanged = true;
+  auto check = [&](access_base_t *access) {
+    if (access->m_state & READ) {
+      auto &lock = *access->m_lock;
+      if (t < (lock.m_clock.load() & ~waiting_bit) && !holds(transaction, lock))
+        unchanged = false;
     }
-    work = work->m_next;
-  } while (work);
+  };
+  if (auto root = transaction->m_accesses) {
+    Static::in_order(root, check);
+  } else {
+    for (size_t i = 0, n = transaction->m_n_flat; unchanged && i < n; ++i)
+      check(transaction->m_flat[i]);
+  }
+  if (!unchanged)
+    return false;
+
+  if constexpr (counting)
+    count(offsetof(stats, n_extensions));
+  transaction->m_start = c;
+  return true;
 }
 
 void trade_v1::Private::retry(transaction_base_t *transaction) {
+  if (auto alternative = transaction->m_alternative) {
+#if TRADE_V1_ABORT_LONGJMP
+    std::longjmp(alternative->m_retry, 1);
+#else
+    throw alternative;
+#endif
+  }
+
+  if constexpr (counting)
+    if (Static::s_woken)
+      count(offsetof(stats, n_spurious_wakeups));
+
   {
     access_base_t **tail = &transaction->m_accesses;
 
     Static::destructively_in_order(
-        *tail, [&](auto node) { Static::append_to(&tail, node); });
+        transaction, [&](auto node) { Static::append_to(&tail, node); });
+
+    *tail = nullptr;
+  }
+
+  // Blocking is not contention.
+  transaction->m_n_aborts -= 1;
+
+  if (transaction->m_irrevocable) {
+    // Locks held by an irrevocable transaction are released before waiting and
+    // changes are detected relative to the clock before the release.
+    transaction->m_start = s_clock.load();
+    for (auto it = transaction->m_accesses; it; it = it->m_children[1])
+      Static::unlock_irrevocably(*it->m_lock);
+    leave_irrevocable(transaction);
   }
 
+  // Locks acquired on encounter are released before waiting.
+  Static::unlock_encountered(transaction, nullptr);
+
+  // The oldest transaction must not keep younger ones waiting while blocked.
+  if (transaction->m_ticket)
+    release_priority(transaction);
+
   if (auto root = transaction->m_accesses) {
-    signal_t signal;
-    Static::wait(transaction->m_start, signal, root);
+    Static::wait(transaction->m_start, root);
   } else {
     auto limit = transaction->m_limit;
     if (!limit)
       transaction->m_alloc = limit + 1;
   }
 
-  throw transaction;
+  abort(transaction, abort_reason::retry);
 }
 
 void trade_v1::Private::destroy(transaction_base_t *transaction) {
-  Static::destructively_in_order(transaction->m_accesses,
-                                 [](auto node) { node->m_destroy(0, node); });
+  if constexpr (counting)
+    Static::count_attempt_size();
+  for (auto it = transaction->m_undo; it; it = it->m_next)
+    it->m_undo(it, false);
+  Static::unlock_encountered(transaction, nullptr);
+  if (transaction->m_irrevocable) {
+    Static::destructively_in_order(transaction, [](auto node) {
+      if (auto lock = node->m_lock)
+        Static::unlock_irrevocably(*lock);
+      node->m_destroy(0, node);
+    });
+    leave_irrevocable(transaction);
+  } else {
+    Static::destructively_in_order(
+        transaction, [](auto node) { node->m_destroy(0, node); });
+  }
 }
 
+bool trade_v1::Private::attempt_alternative(transaction_base_t *transaction,
+                                            void (*body)(void *context),
+                                            void *context) {
+  alternative_t alternative;
+  alternative.m_outer = transaction->m_alternative;
+  alternative.m_undo = transaction->m_undo;
+  alternative.m_locked = transaction->m_locked;
+  alternative.m_n_commit_hooks = s_n_commit_hooks;
+  alternative.m_written = transaction->m_written;
+  alternative.m_id = ++transaction->m_n_alternatives;
+  transaction->m_alternative = &alternative;
+
+#if TRADE_V1_ABORT_LONGJMP
+  if (setjmp(alternative.m_retry)) {
+    Static::roll_back(transaction, alternative);
+    return false;
+  }
+#if TRADE_V1_EXCEPTIONS
+  try {
+    body(context);
+  } catch (...) {
+    transaction->m_alternative = alternative.m_outer;
+    throw;
+  }
+#else
+  body(context);
+#endif
+#else
+  try {
+    body(context);
+  } catch (alternative_t *) {
+    Static::roll_back(transaction, alternative);
+    return false;
+  } catch (...) {
+    transaction->m_alternative = alternative.m_outer;
+    throw;
+  }
+#endif
+
+  transaction->m_alternative = alternative.m_outer;
+  return true;
+}
+
+#if TRADE_V1_ABORT_LONGJMP
+bool trade_v1::Private::attempt(transaction_base_t *transaction,
+                                bool (*body)(void *context),
+                                void *context) {
+  if (setjmp(transaction->m_restart)) {
+    destroy(transaction);
+    return false;
+  }
+
+  bool committed;
+#if TRADE_V1_EXCEPTIONS
+  try {
+    committed = body(context);
+  } catch (...) {
+    if constexpr (counting)
+      count_user_exception();
+    destroy(transaction);
+    throw;
+  }
+#else
+  committed = body(context);
+#endif
+  destroy(transaction);
+  return committed;
+}
+#endif
+
 bool trade_v1::Private::try_commit(transaction_base_t *transaction) {
+  // Every read has already been checked against the start time, so a
+  // transaction that has written nothing is consistent as of its start time
+  // and can commit without touching the clock or any locks.
+  if (!transaction->m_written) {
+    if constexpr (counting) {
+      count(offsetof(stats, n_commits));
+      Static::s_woken = false;
+    }
+    return true;
+  }
+
+  if (transaction->m_policy == contention_policy::priority &&
+      !transaction->m_encounter && !transaction->m_irrevocable)
+    Static::yield_to_older(transaction);
+
   auto t = transaction->m_start;
 
+  // Locks acquired on encounter are released below along with the other locks
+  // of written atoms.
+  transaction->m_locked = nullptr;
+
   access_base_t writes;
-  writes.m_lock_ix = -1;
+  writes.m_lock = nullptr;
 
   {
-    access_base_t *root = transaction->m_accesses;
-
     access_base_t *writes_last = &writes;
     access_base_t **reads_tail = &transaction->m_accesses;
 
-    Static::destructively_in_order(root, [&](auto node) {
-      if (writes_last && WRITTEN <= node->m_state) {
-        auto lock_ix = node->m_lock_ix;
-        if (lock_ix == writes_last->m_lock_ix) {
-          writes_last->m_lock_ix = -1;
+    // Version of the lock last acquired, which may be newer than the start
+    // time if the lock was acquired for a blind add.
+    clock_t held = 0;
+
+    Static::destructively_in_order(transaction, [&](auto node) {
+      if (writes_last && (node->m_state & WRITTEN)) {
+        auto &lock = *node->m_lock;
+        if (&lock == writes_last->m_lock &&
+            (!(node->m_state & READ) || (held & ~waiting_bit) <= t)) {
+          writes_last->m_lock = nullptr;
+          Static::append_to(&writes_last, node);
+        } else if (&lock == writes_last->m_lock) {
+          if constexpr (counting)
+            count_abort(abort_reason::invalidated);
+          if constexpr (profiling)
+            profile_conflict(node->m_atom, lock, t);
+          Static::advance(held);
+          Static::append_to(&reads_tail, node);
+          writes_last = writes_last->m_children[1] = nullptr;
+          Static::unlock_and_destroy(writes.m_children[1]);
+        } else if (transaction->m_encounter) {
+          // Every written atom has its lock acquired on encounter.
+          held = ~lock.m_clock.load(std::memory_order_relaxed);
           Static::append_to(&writes_last, node);
         } else {
-          auto &lock = s_locks[node->m_lock_ix];
-          auto s = lock.m_clock.load(std::memory_order_relaxed);
-          if (t < s || !lock.m_clock.compare_exchange_strong(
-                           s, ~s, std::memory_order_acquire)) {
+          // Locks already held by the irrevocable transaction have only the
+          // sign bit set and are switched to the ordinary held state.
+          auto s = Static::await_unlocked(transaction, lock);
+          if (!(node->m_state & DELTA ? Static::try_acquire_blind(lock, s)
+                                      : Static::try_acquire(lock, t, s))) {
+            if constexpr (counting)
+              count_abort(static_cast<signed_clock_t>(s) < 0
+                              ? abort_reason::locked
+                              : abort_reason::invalidated);
+            if constexpr (profiling)
+              profile_conflict(node->m_atom, lock, t);
+            Static::advance(s);
             Static::append_to(&reads_tail, node);
             writes_last = writes_last->m_children[1] = nullptr;
             Static::unlock_and_destroy(writes.m_children[1]);
           } else {
+            if constexpr (counting)
+              count(offsetof(stats, n_lock_acquisitions));
+            held = s;
             Static::append_to(&writes_last, node);
           }
         }
@@ -380,37 +1425,83 @@ bool trade_v1::Private::try_commit(transaction_base_t *transaction) {
     writes_last->m_children[1] = nullptr;
   }
 
-  auto u = s_clock++;
+  // Locks are acquired above with sequentially consistent operations so that
+  // a transaction that starts with a clock value at or after the write version
+  // obtained below is guaranteed to see the locks as held.
+  clock_t u;
+  bool validate;
+  switch (s_clock_scheme) {
+  case clock_scheme::pass_on_failure:
+    u = s_clock.load();
+    if (s_clock.compare_exchange_strong(u, u + 1)) {
+      validate = u != t;
+      u += 1;
+    } else {
+      validate = true;
+    }
+    break;
+  case clock_scheme::advance_on_abort:
+    u = s_clock.load() + 1;
+    validate = true;
+    break;
+  default:
+    u = s_clock++;
+    validate = u != t;
+    u += 1;
+  }
 
-  if (u != t) {
+  // Every atom accessed by an irrevocable transaction has been locked since its
+  // first access, so none of its reads can have been invalidated.
+  if (validate && !transaction->m_irrevocable) {
     auto wr = writes.m_children[1];
     for (auto it = transaction->m_accesses; it; it = it->m_children[1]) {
-      auto ix = it->m_lock_ix;
-      auto &lock = s_locks[ix];
-      auto s = lock.m_clock.load(std::memory_order_relaxed);
-      if (s <= t)
+      auto lock = it->m_lock;
+      auto s = lock->m_clock.load(std::memory_order_relaxed);
+      if ((s & ~waiting_bit) <= t)
         continue;
       if (static_cast<signed_clock_t>(s) < 0) {
-        while (wr) {
-          if (wr->m_lock_ix < ix) {
-            wr = wr->m_children[1];
-          } else if (wr->m_lock_ix == ix) {
-            break;
-          } else {
-            Static::unlock_and_destroy(writes.m_children[1]);
-            return false;
-          }
-        }
+        while (wr && wr->m_lock < lock)
+          wr = wr->m_children[1];
+        // A lock held by this transaction is checked against the version it
+        // had when acquired.
+        if (wr && wr->m_lock == lock && (~s & ~waiting_bit) <= t)
+          continue;
+      } else {
+        Static::advance(s);
       }
+      if constexpr (counting)
+        count_abort(abort_reason::invalidated);
+      if constexpr (profiling)
+        profile_conflict(it->m_atom, *lock, t);
+      Static::unlock_and_destroy(writes.m_children[1]);
+      return false;
     }
   }
 
-  u += 1;
-  for (auto it = writes.m_children[1]; it; it = it->m_children[1])
+  // Writes are recorded before the locks are released, so that a transaction
+  // that conflicts with the new version sees the write.
+  for (auto it = writes.m_children[1]; it; it = it->m_children[1]) {
+    if constexpr (profiling)
+      profile_write(it->m_atom, u);
     it->m_destroy(u, it);
+  }
+
+  // Waiters are woken after the locks are released, so that they see the new
+  // versions.  Only the last write under a lock has the lock.
+  for (auto it = writes.m_children[1], first = it; it; it = it->m_children[1])
+    if (auto lock = it->m_lock) {
+      if (Static::has_waiters(lock->m_clock.load(std::memory_order_relaxed)))
+        Static::signal(*lock, first, it);
+      first = it->m_children[1];
+    }
 
   for (auto it = writes.m_children[1]; it; it = it->m_children[1])
     it->m_destroy(0, it);
 
+  if constexpr (counting) {
+    count(offsetof(stats, n_commits));
+    Static::s_woken = false;
+  }
+
   return true;
 }